@@ -0,0 +1,254 @@
+//*****************************************************************************************//
+//  canny.cpp - Canny edge thinning and hysteresis on top of the CPU Sobel gradient
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "canny.h"
+#include "workers.h"
+
+#define CANNY_WEAK		1
+#define CANNY_STRONG	2
+
+bool canny_alloc(canny_t *canny, unsigned int width, unsigned int height)
+{
+	unsigned long size = (unsigned long)width * height;
+	
+	canny->width = width;
+	canny->height = height;
+	canny->cls = (unsigned char *)malloc(size);
+	canny->parent = (int *)malloc(size * sizeof(int));
+	canny->keep = (unsigned char *)malloc(size);
+	
+	if(!canny->cls || !canny->parent || !canny->keep)
+	{
+		canny_free(canny);
+		return false;
+	}
+	return true;
+}
+
+void canny_free(canny_t *canny)
+{
+	free(canny->cls);
+	free(canny->parent);
+	free(canny->keep);
+	canny->cls = NULL;
+	canny->parent = NULL;
+	canny->keep = NULL;
+}
+
+//***************************************************************//
+// Union-find. The root of a component is its smallest pixel index.
+// canny_find() halves paths and must only be used on trees that no
+// other thread touches; canny_root() only reads.
+//***************************************************************//
+static inline int canny_find(int *parent, int p)
+{
+	while(parent[p] != p)
+	{
+		parent[p] = parent[parent[p]];
+		p = parent[p];
+	}
+	return p;
+}
+
+static inline int canny_root(const int *parent, int p)
+{
+	while(parent[p] != p)
+		p = parent[p];
+	return p;
+}
+
+static inline void canny_union(int *parent, int p, int q)
+{
+	p = canny_find(parent, p);
+	q = canny_find(parent, q);
+	if(p < q)
+		parent[q] = p;
+	else if(q < p)
+		parent[p] = q;
+}
+
+//***************************************************************//
+// Neighbour offsets (dx, dy) along each quantized gradient direction.
+// Angles run from +x towards +y (down the image), so 45 degrees
+// points down and to the right.
+//***************************************************************//
+static const int canny_dx[CANNY_ORIENT_BINS] = { 1, 1, 0, -1 };
+static const int canny_dy[CANNY_ORIENT_BINS] = { 0, 1, 1,  1 };
+
+struct canny_args
+{
+	canny_t *canny;
+	const gradient_t *grad;
+	unsigned int low;
+	unsigned int high;
+	edge_mask_t *edges;
+	unsigned char sector[256];	// orientation bin -> nearest of the CANNY_ORIENT_BINS directions
+};
+
+//***************************************************************//
+// Pass 1 on one band: NMS, double threshold and union-find of the
+// candidates inside the band. Only the band's own pixels are linked,
+// the seam with the band above is left to canny_merge_seams().
+//***************************************************************//
+static void canny_band_label(void *arg, int index, int count)
+{
+	struct canny_args *job = (struct canny_args *)arg;
+	canny_t *canny = job->canny;
+	const gradient_t *grad = job->grad;
+	int width = canny->width;
+	int height = canny->height;
+	int y0 = (int)((unsigned long)height * index / count);
+	int y1 = (int)((unsigned long)height * (index+1) / count);
+	
+	for(int y=y0; y<y1; y++)
+	{
+		unsigned long row = (unsigned long)y * width;
+		
+		for(int x=0; x<width; x++)
+		{
+			unsigned long i = row + x;
+			unsigned int m = grad->mag[i];
+			int p = (int)i;
+			
+			canny->cls[i] = 0;
+			canny->parent[i] = p;
+			canny->keep[i] = 0;
+			if(m < job->low)
+				continue;
+			
+			// Keep only the maximum across the edge, ties go to the first pixel
+			int dir = job->sector[grad->orient[i]];
+			int dx = canny_dx[dir], dy = canny_dy[dir];
+			int xa = x + dx, ya = y + dy, xb = x - dx, yb = y - dy;
+			unsigned int ma = (xa >= 0 && xa < width && ya >= 0 && ya < height) ? grad->mag[xa + (unsigned long)ya*width] : 0;
+			unsigned int mb = (xb >= 0 && xb < width && yb >= 0 && yb < height) ? grad->mag[xb + (unsigned long)yb*width] : 0;
+			if(m < ma || m <= mb)
+				continue;
+			
+			canny->cls[i] = (m >= job->high) ? CANNY_STRONG : CANNY_WEAK;
+			
+			// Link to the candidates already visited in this band
+			if(x > 0 && canny->cls[i-1])
+				canny_union(canny->parent, p, p-1);
+			if(y > y0)
+			{
+				unsigned long up = i - width;
+				if(x > 0 && canny->cls[up-1])
+					canny_union(canny->parent, p, (int)up-1);
+				if(canny->cls[up])
+					canny_union(canny->parent, p, (int)up);
+				if(x+1 < width && canny->cls[up+1])
+					canny_union(canny->parent, p, (int)up+1);
+			}
+		}
+	}
+}
+
+//***************************************************************//
+// Link the first row of every band to the last row of the one above.
+// This touches (bands-1) rows only, so it runs on the calling thread.
+//***************************************************************//
+static void canny_merge_seams(canny_t *canny, int count)
+{
+	int width = canny->width;
+	
+	for(int b=1; b<count; b++)
+	{
+		int y = (int)((unsigned long)canny->height * b / count);
+		if(y == 0 || y >= (int)canny->height)
+			continue;
+		
+		unsigned long row = (unsigned long)y * width;
+		for(int x=0; x<width; x++)
+		{
+			unsigned long i = row + x;
+			if(!canny->cls[i])
+				continue;
+			unsigned long up = i - width;
+			if(x > 0 && canny->cls[up-1])
+				canny_union(canny->parent, (int)i, (int)up-1);
+			if(canny->cls[up])
+				canny_union(canny->parent, (int)i, (int)up);
+			if(x+1 < width && canny->cls[up+1])
+				canny_union(canny->parent, (int)i, (int)up+1);
+		}
+	}
+}
+
+//***************************************************************//
+// Pass 2: flag every component root that has a strong pixel. Bands
+// may flag the same root; they all store the same value.
+//***************************************************************//
+static void canny_band_flag(void *arg, int index, int count)
+{
+	struct canny_args *job = (struct canny_args *)arg;
+	canny_t *canny = job->canny;
+	unsigned long i0 = (unsigned long)canny->height * index / count * canny->width;
+	unsigned long i1 = (unsigned long)canny->height * (index+1) / count * canny->width;
+	
+	for(unsigned long i=i0; i<i1; i++)
+	{
+		if(canny->cls[i] == CANNY_STRONG)
+			canny->keep[canny_root(canny->parent, (int)i)] = 1;
+	}
+}
+
+//***************************************************************//
+// Pass 3: every candidate in a flagged component is an edge. Mask
+// rows start on a word boundary so bands never share a word.
+//***************************************************************//
+static void canny_band_output(void *arg, int index, int count)
+{
+	struct canny_args *job = (struct canny_args *)arg;
+	canny_t *canny = job->canny;
+	int width = canny->width;
+	int y0 = (int)((unsigned long)canny->height * index / count);
+	int y1 = (int)((unsigned long)canny->height * (index+1) / count);
+	
+	for(int y=y0; y<y1; y++)
+	{
+		uint64_t *bits = edge_mask_row(job->edges, y);
+		unsigned long row = (unsigned long)y * width;
+		
+		for(unsigned int k=0; k<job->edges->words_per_row; k++)
+		{
+			uint64_t word = 0;
+			for(int g=0; g<64 && k*64+g<(unsigned int)width; g++)
+			{
+				unsigned long i = row + k*64 + g;
+				if(canny->cls[i] && canny->keep[canny_root(canny->parent, (int)i)])
+					word |= (uint64_t)1 << g;
+			}
+			bits[k] = word;
+		}
+	}
+}
+
+void CPU_canny(canny_t *canny, const gradient_t *grad, unsigned int low, unsigned int high, edge_mask_t *edges)
+{
+	struct canny_args job = { canny, grad, low, high, edges, { 0 } };
+	int bins = grad->orient_bins;
+	
+	if(bins < CANNY_ORIENT_BINS || bins % CANNY_ORIENT_BINS != 0)
+	{
+		printf("Canny needs a gradient with a multiple of %d orientation bins.\n", CANNY_ORIENT_BINS);
+		return;
+	}
+	for(int b=0; b<bins; b++)
+		job.sector[b] = (unsigned char)(((b * CANNY_ORIENT_BINS + bins/2) / bins) % CANNY_ORIENT_BINS);
+	if(low > high)
+		job.low = high;
+	
+	workers_run(canny_band_label, &job);
+	canny_merge_seams(canny, workers_count());
+	workers_run(canny_band_flag, &job);
+	workers_run(canny_band_output, &job);
+}
@@ -0,0 +1,47 @@
+//*****************************************************************************************//
+//  canny.h - Canny edge thinning and hysteresis on top of the CPU Sobel gradient
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	The Sobel magnitude is several pixels wide across every edge, and each of those
+//	pixels costs a full set of Hough votes. Canny keeps one pixel across the edge:
+//
+//	1. non-maximum suppression along the gradient direction quantized to 0, 45, 90
+//	   and 135 degrees (a gradient_t with 4 orientation bins, or a multiple of 4
+//	   that is folded onto the nearest of the four),
+//	2. a double threshold into weak and strong candidates,
+//	3. hysteresis: weak pixels survive only if they are 8-connected to a strong one.
+//
+//	Hysteresis is done as connected component labeling with union-find rather than a
+//	serial flood fill. Each worker labels its own band of rows, the seams between
+//	bands are merged afterwards, and every component that holds a strong pixel is
+//	kept. Steps 1 and 2 run in the same pass as the band labeling.
+//
+//*****************************************************************************************//
+#ifndef CANNY_H
+#define CANNY_H
+
+#include "edgemask.h"
+#include "gradient.h"
+
+#define CANNY_ORIENT_BINS	4
+
+typedef struct
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned char *cls;		// per pixel: 0 suppressed, 1 weak, 2 strong
+	int *parent;			// union-find forest over the candidate pixels
+	unsigned char *keep;	// per component root: holds a strong pixel
+} canny_t;
+
+// Allocate buffers for a width x height image, returns false if out of memory
+bool canny_alloc(canny_t *canny, unsigned int width, unsigned int height);
+void canny_free(canny_t *canny);
+
+// Thin and link the edges of grad (which needs a multiple of CANNY_ORIENT_BINS
+// orientation bins) into edges. low and high are in the units of grad->norm, pixels at or
+// above high are strong and pixels at or above low are weak.
+void CPU_canny(canny_t *canny, const gradient_t *grad, unsigned int low, unsigned int high, edge_mask_t *edges);
+
+#endif
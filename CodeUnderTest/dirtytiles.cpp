@@ -0,0 +1,117 @@
+//*****************************************************************************************//
+//  dirtytiles.cpp - Change detection between continuous frames for incremental transforms
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "dirtytiles.h"
+#include "workers.h"
+
+bool dirty_tiles_alloc(dirty_tiles_t *tiles, unsigned int width, unsigned int height, unsigned int sad_threshold)
+{
+	tiles->width = width;
+	tiles->height = height;
+	tiles->tiles_x = (width + DIRTY_TILE - 1) / DIRTY_TILE;
+	tiles->tiles_y = (height + DIRTY_TILE - 1) / DIRTY_TILE;
+	tiles->sad_threshold = sad_threshold;
+	tiles->primed = false;
+	tiles->ref = (unsigned char *)malloc((unsigned long)width * height);
+	tiles->dirty = (unsigned char *)malloc(tiles->tiles_x * tiles->tiles_y);
+	
+	if(!tiles->ref || !tiles->dirty)
+	{
+		dirty_tiles_free(tiles);
+		return false;
+	}
+	return true;
+}
+
+void dirty_tiles_free(dirty_tiles_t *tiles)
+{
+	free(tiles->ref);
+	free(tiles->dirty);
+	tiles->ref = NULL;
+	tiles->dirty = NULL;
+}
+
+//***************************************************************//
+// Sum of absolute differences of one w x h tile. psadbw sums 8
+// byte differences at a time into each 64 bit half.
+//***************************************************************//
+static unsigned int tile_sad(const unsigned char *a, const unsigned char *b, unsigned int stride, int w, int h)
+{
+	unsigned int sad = 0;
+	
+	for(int y=0; y<h; y++)
+	{
+		const unsigned char *ra = a + (unsigned long)y*stride;
+		const unsigned char *rb = b + (unsigned long)y*stride;
+		int x = 0;
+#if defined(__SSE2__)
+		__m128i acc = _mm_setzero_si128();
+		for(; x+16<=w; x+=16)
+			acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(ra+x)), _mm_loadu_si128((const __m128i *)(rb+x))));
+		sad += (unsigned int)_mm_cvtsi128_si32(acc) + (unsigned int)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+		for(; x<w; x++)
+			sad += abs((int)ra[x] - (int)rb[x]);
+	}
+	return sad;
+}
+
+struct dirty_tiles_args
+{
+	dirty_tiles_t *tiles;
+	const unsigned char *img;
+};
+
+static void dirty_tiles_band(void *arg, int index, int count)
+{
+	struct dirty_tiles_args *job = (struct dirty_tiles_args *)arg;
+	dirty_tiles_t *tiles = job->tiles;
+	unsigned int width = tiles->width;
+	unsigned int ty0 = (unsigned int)((unsigned long)tiles->tiles_y * index / count);
+	unsigned int ty1 = (unsigned int)((unsigned long)tiles->tiles_y * (index+1) / count);
+	
+	for(unsigned int ty=ty0; ty<ty1; ty++)
+	{
+		unsigned int y0 = ty * DIRTY_TILE;
+		int h = (y0 + DIRTY_TILE <= tiles->height) ? DIRTY_TILE : tiles->height - y0;
+		
+		for(unsigned int tx=0; tx<tiles->tiles_x; tx++)
+		{
+			unsigned int x0 = tx * DIRTY_TILE;
+			int w = (x0 + DIRTY_TILE <= width) ? DIRTY_TILE : width - x0;
+			unsigned long offset = (unsigned long)y0*width + x0;
+			bool dirty = !tiles->primed ||
+			             tile_sad(&job->img[offset], &tiles->ref[offset], width, w, h) > tiles->sad_threshold;
+			
+			tiles->dirty[ty * tiles->tiles_x + tx] = dirty;
+			if(dirty)
+			{
+				for(int y=0; y<h; y++)
+					memcpy(&tiles->ref[offset + (unsigned long)y*width], &job->img[offset + (unsigned long)y*width], w);
+			}
+		}
+	}
+}
+
+unsigned int CPU_dirty_tiles_update(dirty_tiles_t *tiles, const unsigned char *img)
+{
+	struct dirty_tiles_args job = { tiles, img };
+	unsigned int count = 0;
+	
+	workers_run(dirty_tiles_band, &job);
+	tiles->primed = true;
+	
+	for(unsigned int i=0; i<tiles->tiles_x * tiles->tiles_y; i++)
+		count += tiles->dirty[i];
+	return count;
+}
@@ -0,0 +1,45 @@
+//*****************************************************************************************//
+//  dirtytiles.h - Change detection between continuous frames for incremental transforms
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	A fixed camera sees mostly the same scene every frame. The frame is split into
+//	DIRTY_TILE x DIRTY_TILE tiles and each tile's sum of absolute differences against
+//	the frame the current output was computed from decides whether the tile changed.
+//	Only changed tiles (and the one pixel ring of output around them that reads their
+//	pixels) need to be transformed again.
+//
+//*****************************************************************************************//
+#ifndef DIRTYTILES_H
+#define DIRTYTILES_H
+
+#define DIRTY_TILE	32
+
+typedef struct
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int tiles_x;
+	unsigned int tiles_y;
+	unsigned int sad_threshold;	// a tile is dirty when its SAD is above this
+	bool primed;				// false until the first frame has been seen
+	unsigned char *ref;			// the input each tile was last transformed from
+	unsigned char *dirty;		// tiles_x*tiles_y flags
+} dirty_tiles_t;
+
+// Allocate for a width x height frame, returns false if out of memory
+bool dirty_tiles_alloc(dirty_tiles_t *tiles, unsigned int width, unsigned int height, unsigned int sad_threshold);
+void dirty_tiles_free(dirty_tiles_t *tiles);
+
+static inline bool dirty_tile(const dirty_tiles_t *tiles, int tx, int ty)
+{
+	return tx >= 0 && ty >= 0 && tx < (int)tiles->tiles_x && ty < (int)tiles->tiles_y &&
+	       tiles->dirty[ty * tiles->tiles_x + tx];
+}
+
+// Compare img with the reference tile by tile on the worker threads, flag
+// the dirty tiles and copy them into the reference. Every tile is dirty on
+// the first frame. Returns the number of dirty tiles.
+unsigned int CPU_dirty_tiles_update(dirty_tiles_t *tiles, const unsigned char *img);
+
+#endif
@@ -0,0 +1,129 @@
+//*****************************************************************************************//
+//  edgemask.cpp - Bit-packed edge masks shared by the CPU transforms
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edgemask.h"
+#include "ppm.h"
+
+bool edge_mask_alloc(edge_mask_t *mask, unsigned int width, unsigned int height)
+{
+	mask->width = width;
+	mask->height = height;
+	mask->words_per_row = (width + 63) / 64;
+	mask->bits = (uint64_t *)calloc((unsigned long)mask->words_per_row * height, sizeof(uint64_t));
+	return mask->bits != NULL;
+}
+
+void edge_mask_free(edge_mask_t *mask)
+{
+	free(mask->bits);
+	mask->bits = NULL;
+}
+
+void edge_mask_clear(edge_mask_t *mask)
+{
+	memset(mask->bits, 0, (unsigned long)mask->words_per_row * mask->height * sizeof(uint64_t));
+}
+
+unsigned long edge_mask_count(const edge_mask_t *mask)
+{
+	unsigned long count = 0;
+	unsigned long words = (unsigned long)mask->words_per_row * mask->height;
+	
+	for(unsigned long i = 0; i < words; i++)
+		count += __builtin_popcountll(mask->bits[i]);
+	return count;
+}
+
+unsigned long edge_mask_points(const edge_mask_t *mask, int *xs, int *ys, unsigned long max)
+{
+	unsigned long n = 0;
+	
+	for(unsigned int y = 0; y < mask->height; y++)
+	{
+		const uint64_t *row = edge_mask_row(mask, y);
+		for(unsigned int k = 0; k < mask->words_per_row; k++)
+		{
+			uint64_t word = row[k];
+			while(word)
+			{
+				if(n == max)
+					return n;
+				xs[n] = k*64 + __builtin_ctzll(word);
+				ys[n] = y;
+				n++;
+				word &= word - 1;	// clear lowest set bit
+			}
+		}
+	}
+	return n;
+}
+
+void edge_mask_from_image(edge_mask_t *mask, const unsigned char *img, int threshold)
+{
+	for(unsigned int y = 0; y < mask->height; y++)
+	{
+		uint64_t *row = edge_mask_row(mask, y);
+		const unsigned char *pixels = &img[(unsigned long)y * mask->width];
+		for(unsigned int k = 0; k < mask->words_per_row; k++)
+		{
+			uint64_t word = 0;
+			for(unsigned int b = 0; b < 64 && k*64 + b < mask->width; b++)
+			{
+				if(pixels[k*64 + b] > threshold)
+					word |= (uint64_t)1 << b;
+			}
+			row[k] = word;
+		}
+	}
+}
+
+void edge_mask_to_image(const edge_mask_t *mask, unsigned char *img)
+{
+	for(unsigned int y = 0; y < mask->height; y++)
+		for(unsigned int x = 0; x < mask->width; x++)
+			img[(unsigned long)y*mask->width + x] = edge_mask_get(mask, x, y) ? 255 : 0;
+}
+
+void edge_mask_dump(const edge_mask_t *mask, std::string filename)
+{
+	unsigned int width = mask->width, height = mask->height;
+	
+	if(filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".pbm") == 0)
+	{
+		// PBM rows are byte padded with the leftmost pixel in the MSB
+		unsigned int stride = (width + 7) / 8;
+		unsigned char *raster = (unsigned char *)malloc((unsigned long)stride * height);
+		if(raster == NULL)
+			return;
+		for(unsigned int y = 0; y < height; y++)
+		{
+			const unsigned char *bytes = (const unsigned char *)edge_mask_row(mask, y); // little endian
+			for(unsigned int i = 0; i < stride; i++)
+			{
+				unsigned char b = bytes[i];
+				b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+				b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+				b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+				raster[(unsigned long)y*stride + i] = b;
+			}
+		}
+		dump_pbm_data(filename, width, height, raster);
+		free(raster);
+	}
+	else
+	{
+		unsigned char *img = (unsigned char *)malloc((unsigned long)width * height);
+		if(img == NULL)
+			return;
+		edge_mask_to_image(mask, img);
+		dump_ppm_data(filename, width, height, 1, img);
+		free(img);
+	}
+}
@@ -0,0 +1,72 @@
+//*****************************************************************************************//
+//  edgemask.h - Bit-packed edge masks shared by the CPU transforms
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	A thresholded edge image only carries one bit per pixel, so it is stored as one
+//	bit per pixel: 8x less memory traffic than the 0/255 byte images for anything
+//	that only needs to know where the edges are (Hough voting in particular).
+//
+//	Layout: each row starts on a 64 bit word boundary, bit x%64 of word x/64 is
+//	pixel x, and the padding bits past the end of a row are always zero. Set bits
+//	can be counted with popcount and walked with count-trailing-zeros, see
+//	edge_mask_count() and edge_mask_points().
+//
+//*****************************************************************************************//
+#ifndef EDGEMASK_H
+#define EDGEMASK_H
+
+#include <stdint.h>
+#include <string>
+
+typedef struct
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int words_per_row;
+	uint64_t *bits;
+} edge_mask_t;
+
+// Allocate a cleared mask, returns false if out of memory
+bool edge_mask_alloc(edge_mask_t *mask, unsigned int width, unsigned int height);
+void edge_mask_free(edge_mask_t *mask);
+void edge_mask_clear(edge_mask_t *mask);
+
+static inline uint64_t *edge_mask_row(const edge_mask_t *mask, unsigned int y)
+{
+	return mask->bits + (unsigned long)y * mask->words_per_row;
+}
+
+static inline bool edge_mask_get(const edge_mask_t *mask, unsigned int x, unsigned int y)
+{
+	return (edge_mask_row(mask, y)[x >> 6] >> (x & 63)) & 1;
+}
+
+static inline void edge_mask_set(edge_mask_t *mask, unsigned int x, unsigned int y)
+{
+	edge_mask_row(mask, y)[x >> 6] |= (uint64_t)1 << (x & 63);
+}
+
+static inline void edge_mask_reset(edge_mask_t *mask, unsigned int x, unsigned int y)
+{
+	edge_mask_row(mask, y)[x >> 6] &= ~((uint64_t)1 << (x & 63));
+}
+
+// Number of set pixels (popcount over the whole mask)
+unsigned long edge_mask_count(const edge_mask_t *mask);
+
+// Write the coordinates of up to max set pixels, in raster order, to xs/ys.
+// Returns the number written.
+unsigned long edge_mask_points(const edge_mask_t *mask, int *xs, int *ys, unsigned long max);
+
+// Set every pixel of a byte image above threshold (the old "> 250" test)
+void edge_mask_from_image(edge_mask_t *mask, const unsigned char *img, int threshold);
+
+// Expand to a 0/255 byte image, the format the CUDA kernels take edges in
+void edge_mask_to_image(const edge_mask_t *mask, unsigned char *img);
+
+// Dump as PBM (P4, edges black) when filename ends in ".pbm", otherwise as a
+// 0/255 PGM that matches the thresholded Sobel output.
+void edge_mask_dump(const edge_mask_t *mask, std::string filename);
+
+#endif
@@ -0,0 +1,319 @@
+//*****************************************************************************************//
+//  gradient.cpp - Single pass Sobel gradient (magnitude and orientation) on the CPU
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gradient.h"
+#include "stencil.h"
+#include "stencil_simd.h"
+#include "workers.h"
+
+#define MAXRGB			255
+#define SQRT_LUT_BITS	12		// 4096 entry table, sqrt stored with 4 fraction bits
+#define ATAN_LUT_SIZE	256		// atan over [0, 1], 45 degrees = GRAD_ANGLE_STEPS/4
+#define GRAD_CHUNK		256		// pixels of Gx and Gy held at a time
+
+static unsigned short sqrt_lut[1 << SQRT_LUT_BITS];
+static unsigned short atan_lut[ATAN_LUT_SIZE + 1];
+static bool luts_ready = false;
+
+//***************************************************************//
+// Build the sqrt and atan tables, called before any worker runs
+//***************************************************************//
+static void gradient_init_luts(void)
+{
+	if(luts_ready)
+		return;
+	for(int i = 0; i < (1 << SQRT_LUT_BITS); i++)
+		sqrt_lut[i] = (unsigned short)(sqrt((double)i) * 16.0 + 0.5);
+	for(int i = 0; i <= ATAN_LUT_SIZE; i++)
+		atan_lut[i] = (unsigned short)(atan((double)i / ATAN_LUT_SIZE) * (GRAD_ANGLE_STEPS / M_PI) + 0.5);
+	luts_ready = true;
+}
+
+//***************************************************************//
+// Fixed point sqrt: shift the argument into the table range by an
+// even number of bits and shift the root back by half of that
+//***************************************************************//
+static inline unsigned int gradient_sqrt(unsigned int s)
+{
+	int k = 0;
+	if(s >= (1u << SQRT_LUT_BITS))
+	{
+		int bits = 32 - __builtin_clz(s);
+		k = (bits - SQRT_LUT_BITS + 1) / 2;
+	}
+	return (((unsigned int)sqrt_lut[s >> (2*k)] << k) + 8) >> 4;
+}
+
+int gradient_angle(int gx, int gy)
+{
+	int ax, a;
+	
+	// Fold into [0, 180): the orientation of a line has no sign
+	if(gy < 0 || (gy == 0 && gx < 0))
+	{
+		gx = -gx;
+		gy = -gy;
+	}
+	ax = (gx < 0) ? -gx : gx;
+	if(ax >= gy)
+		a = ax ? atan_lut[(gy * ATAN_LUT_SIZE) / ax] : 0;
+	else
+		a = GRAD_ANGLE_STEPS/2 - atan_lut[(ax * ATAN_LUT_SIZE) / gy];
+	if(gx < 0)
+		a = GRAD_ANGLE_STEPS - a;
+	return a & (GRAD_ANGLE_STEPS - 1);
+}
+
+bool gradient_parse_norm(const char *name, grad_norm_t *norm)
+{
+	if(strcmp(name, "l1") == 0)
+		*norm = GRAD_L1;
+	else if(strcmp(name, "l2") == 0)
+		*norm = GRAD_L2;
+	else if(strcmp(name, "sq") == 0)
+		*norm = GRAD_SQ;
+	else
+		return false;
+	return true;
+}
+
+bool gradient_alloc(gradient_t *grad, unsigned int width, unsigned int height, grad_norm_t norm, int orient_bins)
+{
+	gradient_init_luts();
+	
+	grad->width = width;
+	grad->height = height;
+	grad->norm = norm;
+	grad->orient_bins = (orient_bins < 0) ? 0 : (orient_bins > 256) ? 256 : orient_bins;
+	grad->mag = (unsigned short *)malloc((unsigned long)width * height * sizeof(unsigned short));
+	grad->orient = grad->orient_bins ? (unsigned char *)malloc((unsigned long)width * height) : NULL;
+	grad->zero_row = (unsigned char *)calloc(width, 1);
+	
+	if(!grad->mag || !grad->zero_row || (grad->orient_bins && !grad->orient))
+	{
+		gradient_free(grad);
+		return false;
+	}
+	return true;
+}
+
+void gradient_free(gradient_t *grad)
+{
+	free(grad->mag);
+	free(grad->orient);
+	free(grad->zero_row);
+	grad->mag = NULL;
+	grad->orient = NULL;
+	grad->zero_row = NULL;
+}
+
+//***************************************************************//
+// Op at x of one row, zero padded left and right (the rows above
+// and below are zero_row at the top and bottom of the image)
+//***************************************************************//
+template<class Op>
+static inline int gradient_pixel(const unsigned char *a, const unsigned char *m, const unsigned char *b, int x, int width)
+{
+	bool l = (x > 0), r = (x+1 < width);
+	
+	return stencil_apply<Op>(l ? a[x-1] : 0, a[x], r ? a[x+1] : 0,
+	                         l ? m[x-1] : 0, m[x], r ? m[x+1] : 0,
+	                         l ? b[x-1] : 0, b[x], r ? b[x+1] : 0);
+}
+
+//***************************************************************//
+// Signed response of Op over pixels [x0, x1) into out[0..x1-x0),
+// the stencil_span of sobel_cpu.cpp without the clamp to 8 bits
+//***************************************************************//
+template<class Op>
+static void gradient_span(short *out, const unsigned char *a, const unsigned char *m, const unsigned char *b, int width, int x0, int x1)
+{
+	int x = x0;
+	
+	if(x == 0)
+	{
+		out[0] = gradient_pixel<Op>(a, m, b, 0, width);
+		x = 1;
+	}
+	
+	int end = (x1 < width-1) ? x1 : width-1;
+#if defined(__AVX2__)
+	for(; x+32<=end; x+=32)
+	{
+		__m256i lo, hi;
+		stencil_sums_32<Op>(lo, hi, a, m, b, x);
+		_mm256_storeu_si256((__m256i *)&out[x-x0], _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)&out[x-x0+16], _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+#endif
+#if defined(__SSE2__)
+	for(; x+16<=end; x+=16)
+	{
+		__m128i lo, hi;
+		stencil_sums_16<Op>(lo, hi, a, m, b, x);
+		_mm_storeu_si128((__m128i *)&out[x-x0], lo);
+		_mm_storeu_si128((__m128i *)&out[x-x0+8], hi);
+	}
+#endif
+	for(; x<end; x++)
+		out[x-x0] = stencil_apply<Op>(a[x-1], a[x], a[x+1],
+		                              m[x-1], m[x], m[x+1],
+		                              b[x-1], b[x], b[x+1]);
+	
+	if(x1 == width && x < width)
+		out[width-1-x0] = gradient_pixel<Op>(a, m, b, width-1, width);
+}
+
+//***************************************************************//
+// Magnitude of (gx, gy) in the units of Norm
+//***************************************************************//
+template<grad_norm_t Norm> static inline unsigned short gradient_mag(int gx, int gy);
+template<> inline unsigned short gradient_mag<GRAD_L1>(int gx, int gy)
+{
+	return (unsigned short)(abs(gx) + abs(gy));
+}
+template<> inline unsigned short gradient_mag<GRAD_L2>(int gx, int gy)
+{
+	return (unsigned short)gradient_sqrt(gx*gx + gy*gy);
+}
+template<> inline unsigned short gradient_mag<GRAD_SQ>(int gx, int gy)
+{
+	unsigned int sq = gx*gx + gy*gy;
+	return (unsigned short)((sq > 65535) ? 65535 : sq);
+}
+
+//***************************************************************//
+// Gradient rows for one norm, with or without the orientation map.
+// Gx and Gy go through GRAD_CHUNK pixels at a time so they are
+// still in L1 when the magnitudes and orientations read them.
+//***************************************************************//
+template<grad_norm_t Norm, bool Orient>
+static void gradient_rows(gradient_t *grad, const unsigned char *img_in, unsigned int y0, unsigned int y1)
+{
+	int width = grad->width;
+	int bins = grad->orient_bins;
+	short gx[GRAD_CHUNK], gy[GRAD_CHUNK];
+	
+	for(int y = y0; y < (int)y1; y++)
+	{
+		const unsigned char *a = (y > 0) ? &img_in[(unsigned long)(y-1)*width] : grad->zero_row;
+		const unsigned char *m = &img_in[(unsigned long)y*width];
+		const unsigned char *b = (y+1 < (int)grad->height) ? &img_in[(unsigned long)(y+1)*width] : grad->zero_row;
+		unsigned long row = (unsigned long)y * width;
+		
+		for(int x0 = 0; x0 < width; x0 += GRAD_CHUNK)
+		{
+			int x1 = (x0 + GRAD_CHUNK < width) ? x0 + GRAD_CHUNK : width;
+			unsigned short *mag = &grad->mag[row + x0];
+			
+			gradient_span<sobel_x_op>(gx, a, m, b, width, x0, x1);
+			gradient_span<sobel_y_op>(gy, a, m, b, width, x0, x1);
+			for(int i = 0; i < x1 - x0; i++)
+				mag[i] = gradient_mag<Norm>(gx[i], gy[i]);
+			if(Orient)
+			{
+				unsigned char *orient = &grad->orient[row + x0];
+				for(int i = 0; i < x1 - x0; i++)
+				{
+					int bin = (gradient_angle(gx[i], gy[i]) * bins + GRAD_ANGLE_STEPS/2) / GRAD_ANGLE_STEPS;
+					orient[i] = (unsigned char)((bin >= bins) ? bin - bins : bin);
+				}
+			}
+		}
+	}
+}
+
+typedef void (*gradient_rows_fn)(gradient_t *, const unsigned char *, unsigned int, unsigned int);
+
+static gradient_rows_fn gradient_rows_for(grad_norm_t norm, bool orient)
+{
+	switch(norm)
+	{
+	case GRAD_L2:	return orient ? gradient_rows<GRAD_L2, true> : gradient_rows<GRAD_L2, false>;
+	case GRAD_SQ:	return orient ? gradient_rows<GRAD_SQ, true> : gradient_rows<GRAD_SQ, false>;
+	default:		return orient ? gradient_rows<GRAD_L1, true> : gradient_rows<GRAD_L1, false>;
+	}
+}
+
+void CPU_gradient_rows(gradient_t *grad, const unsigned char *img_in, unsigned int y0, unsigned int y1)
+{
+	gradient_rows_for(grad->norm, grad->orient != NULL)(grad, img_in, y0, y1);
+}
+
+//***************************************************************//
+// Band parallel gradient, each band reads its own one row halo
+//***************************************************************//
+struct gradient_band_args
+{
+	gradient_t *grad;
+	const unsigned char *img_in;
+};
+
+static void CPU_gradient_band(void *arg, int index, int count)
+{
+	struct gradient_band_args *band = (struct gradient_band_args *)arg;
+	unsigned int height = band->grad->height;
+	unsigned int y0 = (unsigned int)((unsigned long)height * index / count);
+	unsigned int y1 = (unsigned int)((unsigned long)height * (index+1) / count);
+	CPU_gradient_rows(band->grad, band->img_in, y0, y1);
+}
+
+void CPU_gradient(gradient_t *grad, const unsigned char *img_in)
+{
+	struct gradient_band_args band = { grad, img_in };
+	workers_run(CPU_gradient_band, &band);
+}
+
+unsigned int gradient_threshold(grad_norm_t norm, int threshold)
+{
+	if(threshold < 0)
+		threshold = 0;
+	return (norm == GRAD_SQ) ? (unsigned int)(threshold * threshold) : (unsigned int)threshold;
+}
+
+void gradient_to_mask(const gradient_t *grad, edge_mask_t *mask, unsigned int threshold)
+{
+	for(unsigned int y = 0; y < grad->height; y++)
+	{
+		uint64_t *row = edge_mask_row(mask, y);
+		const unsigned short *mag = &grad->mag[(unsigned long)y * grad->width];
+		for(unsigned int k = 0; k < mask->words_per_row; k++)
+		{
+			uint64_t word = 0;
+			for(unsigned int b = 0; b < 64 && k*64 + b < grad->width; b++)
+			{
+				if(mag[k*64 + b] >= threshold)
+					word |= (uint64_t)1 << b;
+			}
+			row[k] = word;
+		}
+	}
+}
+
+void gradient_to_image(const gradient_t *grad, unsigned char *img_out)
+{
+	unsigned long size = (unsigned long)grad->width * grad->height;
+	
+	for(unsigned long i = 0; i < size; i++)
+	{
+		unsigned int v = (grad->norm == GRAD_SQ) ? (grad->mag[i] >> 8) : grad->mag[i];
+		img_out[i] = (v > MAXRGB) ? MAXRGB : v;
+	}
+}
+
+void gradient_orient_to_image(const gradient_t *grad, unsigned char *img_out)
+{
+	unsigned long size = (unsigned long)grad->width * grad->height;
+	int bins = grad->orient_bins;
+	
+	for(unsigned long i = 0; i < size; i++)
+		img_out[i] = (bins > 1) ? (unsigned char)(grad->orient[i] * MAXRGB / (bins - 1)) : 0;
+}
@@ -0,0 +1,66 @@
+//*****************************************************************************************//
+//  gradient.h - Single pass Sobel gradient (magnitude and orientation) on the CPU
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	Gx and Gy are computed together in one pass over the image (zero padded at the
+//	border, Gx matches CPU_transform) and reduced to a magnitude and, optionally,
+//	a quantized orientation. Sobel, Hough and any later stage that needs edges
+//	should take them from here rather than run their own 3x3 loop.
+//
+//*****************************************************************************************//
+#ifndef GRADIENT_H
+#define GRADIENT_H
+
+#include "edgemask.h"
+
+typedef enum
+{
+	GRAD_L1,	// |Gx| + |Gy|, 0..2040
+	GRAD_L2,	// sqrt(Gx^2 + Gy^2) from a fixed point LUT, 0..1443
+	GRAD_SQ		// Gx^2 + Gy^2 saturated at 65535 (enough for 8 bit thresholds)
+} grad_norm_t;
+
+// Orientations are angles in [0, 180) degrees (the gradient direction modulo
+// 180, i.e. the line normal) in units of 180/GRAD_ANGLE_STEPS degrees.
+#define GRAD_ANGLE_STEPS	1024
+
+typedef struct
+{
+	unsigned int width;
+	unsigned int height;
+	grad_norm_t norm;
+	int orient_bins;		// 0 for no orientation map
+	unsigned short *mag;	// width*height magnitudes
+	unsigned char *orient;	// width*height bins centred on k*180/orient_bins degrees
+	unsigned char *zero_row;	// stands in for the rows above and below the image
+} gradient_t;
+
+// Parse "l1", "l2" or "sq", returns false for anything else
+bool gradient_parse_norm(const char *name, grad_norm_t *norm);
+
+// Allocate buffers for a width x height gradient; orient_bins is 0 or 1..256
+bool gradient_alloc(gradient_t *grad, unsigned int width, unsigned int height, grad_norm_t norm, int orient_bins);
+void gradient_free(gradient_t *grad);
+
+// Gradient of rows [y0, y1), reads one halo row either side
+void CPU_gradient_rows(gradient_t *grad, const unsigned char *img_in, unsigned int y0, unsigned int y1);
+
+// Band parallel gradient on the worker threads (see workers.h)
+void CPU_gradient(gradient_t *grad, const unsigned char *img_in);
+
+// Angle of (gx, gy) in [0, GRAD_ANGLE_STEPS), see above
+int gradient_angle(int gx, int gy);
+
+// Map an 8 bit edge threshold into the units of norm (squared for GRAD_SQ)
+unsigned int gradient_threshold(grad_norm_t norm, int threshold);
+
+// Set mask pixels whose magnitude is at or above threshold (in norm units)
+void gradient_to_mask(const gradient_t *grad, edge_mask_t *mask, unsigned int threshold);
+
+// 8 bit images of the magnitude (clamped; GRAD_SQ is scaled by 1/256) and of
+// the orientation bins (spread over 0..255)
+void gradient_to_image(const gradient_t *grad, unsigned char *img_out);
+void gradient_orient_to_image(const gradient_t *grad, unsigned char *img_out);
+
+#endif
@@ -0,0 +1,71 @@
+//*****************************************************************************************//
+//  histogram.cpp - 8 bit response histograms and Otsu thresholding
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <string.h>
+
+#include "histogram.h"
+
+//***************************************************************//
+// Merge the per worker sub-histograms
+//***************************************************************//
+void histogram_merge(unsigned int *hist, const unsigned int *sub_hists, int count)
+{
+	memset(hist, 0, sizeof(unsigned int) * HIST_BINS);
+	for(int i=0; i<count*HIST_LANES; i++)
+	{
+		const unsigned int *sub = &sub_hists[(unsigned long)i * HIST_BINS];
+		for(int b=0; b<HIST_BINS; b++)
+			hist[b] += sub[b];
+	}
+}
+
+//***************************************************************//
+// Otsu's method: pick t maximising the between class variance of
+// [0, t) and [t, HIST_BINS). Ties keep the lowest t.
+//***************************************************************//
+int histogram_otsu(const unsigned int *hist)
+{
+	double total = 0, sum = 0;
+	double w0 = 0, sum0 = 0, best = -1;
+	int threshold = 1;
+	
+	for(int b=0; b<HIST_BINS; b++)
+	{
+		total += hist[b];
+		sum += (double)b * hist[b];
+	}
+	if(total == 0)
+		return threshold;
+	
+	for(int t=1; t<HIST_BINS; t++)
+	{
+		w0 += hist[t-1];
+		sum0 += (double)(t-1) * hist[t-1];
+		
+		double w1 = total - w0;
+		if(w0 == 0 || w1 == 0)
+			continue;
+		
+		double diff = sum0/w0 - (sum - sum0)/w1;
+		double between = w0 * w1 * diff * diff;
+		if(between > best)
+		{
+			best = between;
+			threshold = t;
+		}
+	}
+	return threshold;
+}
+
+//***************************************************************//
+// Apply a threshold the way sobel_transform does on the GPU
+//***************************************************************//
+void histogram_binarize(unsigned char *img, unsigned long size, int threshold)
+{
+	for(unsigned long i=0; i<size; i++)
+		img[i] = (img[i] >= threshold) ? 255 : 0;
+}
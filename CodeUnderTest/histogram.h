@@ -0,0 +1,48 @@
+//*****************************************************************************************//
+//  histogram.h - 8 bit response histograms and Otsu thresholding
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	Each worker counts the rows it has just written into its own sub-histogram, so
+//	the histogram costs no extra pass over the image and needs no atomics. The
+//	sub-histograms are merged once per frame and Otsu's method picks the threshold
+//	that best separates edge from background responses.
+//
+//*****************************************************************************************//
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#define HIST_BINS	256
+#define HIST_LANES	4		// interleaved tables per worker, see histogram_row()
+#define HIST_SIZE	(HIST_BINS * HIST_LANES)	// entries per worker
+
+//***************************************************************//
+// Count a row into one worker's sub-histogram. Neighbouring pixels
+// go to different tables so runs of equal values (the zero
+// background in particular) do not serialise on one counter.
+//***************************************************************//
+static inline void histogram_row(unsigned int *hist, const unsigned char *row, int width)
+{
+	int x = 0;
+	
+	for(; x+HIST_LANES<=width; x+=HIST_LANES)
+	{
+		hist[0*HIST_BINS + row[x]]++;
+		hist[1*HIST_BINS + row[x+1]]++;
+		hist[2*HIST_BINS + row[x+2]]++;
+		hist[3*HIST_BINS + row[x+3]]++;
+	}
+	for(; x<width; x++)
+		hist[row[x]]++;
+}
+
+// Sum count sub-histograms of HIST_SIZE entries into hist[HIST_BINS]
+void histogram_merge(unsigned int *hist, const unsigned int *sub_hists, int count);
+
+// Otsu threshold of hist: responses >= the returned value are edges
+int histogram_otsu(const unsigned int *hist);
+
+// Set pixels >= threshold to 255 and the rest to 0
+void histogram_binarize(unsigned char *img, unsigned long size, int threshold);
+
+#endif
@@ -39,6 +39,20 @@
 #include <cuda_runtime.h>
 #include "ppm.h"
 #include "options.h"
+#include "canny.h"
+#include "edgemask.h"
+#include "gradient.h"
+#include "hough_cpu.h"
+#include "hough_peaks.h"
+#include "hough_incremental.h"
+#include "hough_circles.h"
+#include "hough_fht.h"
+#include "hough_auto.h"
+#include "perfcount.h"
+#include "hough_prob.h"
+#include "hough_pyramid.h"
+#include "hough_segments.h"
+#include "workers.h"
 
 // Project-Specific Defines
 #define PRIO_ADJUST 	5
@@ -55,17 +69,19 @@
 #define EXIT_IN_IMG_NOT_FOUND		2
 #define EXIT_IN_IMG_FORMATTING		3
 #define EXIT_CUDA_ERR				4
+#define EXIT_CPU_ERR				5
 
 // Debug mode
 //#define DEBUG  
 
 #define TIMING_FILE	"hough_timing.txt"
+#define EDGE_THRESHOLD	251	// houghTransform votes for Sobel values above 250
 #define NS_PER_SEC	1000000000
 #define MS_PER_SEC	1000000
 
 // Kernels (in hough_kernel.cu)
 extern void sobel_wrapper(u_char * frame_in, u_char * frame_out, int width, int height, dim3 grid, dim3 block);
-extern void houghTransform_wrapper(u_char * frame_in, u_char * frame_out, const int hough_h, dim3 grid, dim3 block);
+extern void houghTransform_wrapper(u_char * frame_in, u_char * frame_out, const int hough_h, const float * cos_t, const float * sin_t, const int theta_bins, dim3 grid, dim3 block);
 
 // Global variables for RT threads
 pthread_attr_t rt_sched_attr;
@@ -87,6 +103,41 @@ bool run_once = false;
 int freq = 0;
 std::string imageFilename = DEFAULT_IMAGE;
 double elap_time_d; // in ms
+int num_threads = 1;
+bool use_canny = false;
+int edge_threshold = EDGE_THRESHOLD;
+int canny_low = EDGE_THRESHOLD/2;
+hough_params_t hough_params;
+int peak_count = 0;
+int peak_radius = 2;
+int peak_min = 1;
+std::string lines_file = "hough_lines.txt";
+std::string sparse_file = "";
+bool write_accum = true;
+hough_engine_t hough_engine = HOUGH_ENGINE_BLOCKED;
+float sample_fraction = 1.0f;
+unsigned long vote_budget = 0;
+unsigned int random_seed = 1;
+int segment_votes = 20;
+int min_length = 30;
+int max_gap = 5;
+std::string segments_file = "hough_segments.txt";
+int pyramid_levels = 1;
+int pyramid_candidates = 16;
+int pyramid_refine = 2;
+bool use_incremental = false;
+int rebuild_every = 100;
+int circle_count = 0;
+int circle_rmin = 10;
+int circle_rmax = 100;
+int circle_votes = 30;
+int circle_dist = 0;
+std::string circles_file = "hough_circles.txt";
+bool cache_stats = false;
+float auto_sparse = HOUGH_AUTO_SPARSE;
+float auto_dense = HOUGH_AUTO_DENSE;
+bool auto_calibrate = false;
+std::string auto_log_file = "hough_auto.txt";
 
 //***************************************************************//
 // Initialize CUDA hardware
@@ -170,15 +221,37 @@ void *CUDA_transform_thread(void * threadp)
 	u_char* devInImage;
 	u_char* devTresholded;
 	u_char *A;
+	gradient_t grad;
+	canny_t canny;
+	edge_mask_t edges = {0, 0, 0, NULL};
+	u_char *edge_image;
+	unsigned long edge_pixels = 0;
+	float *cos_t, *sin_t;
+	float *devCos, *devSin;
+	int hough_h;
 	
 	// initialize needed variables
 	int size = img_width*img_height;
-	const int hough_h = (int) (sqrt(2.0) * img_width / 2.0f);
-	hough_height = hough_h * 2;
-	hough_width = 180;
+	hough_geometry(&hough_params, img_width, img_height, &hough_h, &hough_width);
+	hough_height = hough_h * 2 + 1;
 	
 	// Allocate memory for Hough output
     result = (u_char*) malloc(hough_height*hough_width * sizeof(u_char));
+	
+	// Host copy of the edge image: Canny output on the way in, vote count on the way out
+	edge_image = (u_char*) malloc(size * sizeof(u_char));
+	if(edge_image == NULL)
+		{ printf("malloc error.\n"); exit(-1); }
+	
+	// Canny runs on the CPU and replaces the Sobel kernel
+	if(use_canny)
+	{
+		if(!gradient_alloc(&grad, img_width, img_height, GRAD_L1, CANNY_ORIENT_BINS) ||
+		   !canny_alloc(&canny, img_width, img_height) || !edge_mask_alloc(&edges, img_width, img_height))
+			{ printf("Could not allocate the Canny buffers.\n"); exit(-1); }
+		if(num_threads > 1 && !workers_start(num_threads))
+			printf("Could not start worker threads, using a single thread.\n");
+	}
 
 	dim3 dimBlock(BLOCK_SIZE_1, BLOCK_SIZE_2);
 	dim3 dimGrid(img_width / dimBlock.x, img_height / dimBlock.y);
@@ -194,6 +267,28 @@ void *CUDA_transform_thread(void * threadp)
         errVal = cudaMalloc((void**)&A,sizeof(u_char)*hough_height*hough_width);
 	if( errVal != cudaSuccess)
 		{ printf("cudaMalloc error. %s\n",cudaGetErrorString(errVal)); exit(-1); }
+	
+	// sin/cos tables are built and uploaded once, scaled to rho bins
+	cos_t = (float*) malloc(hough_width * sizeof(float));
+	sin_t = (float*) malloc(hough_width * sizeof(float));
+	if(cos_t == NULL || sin_t == NULL)
+		{ printf("malloc error.\n"); exit(-1); }
+	hough_tables(&hough_params, hough_width, cos_t, sin_t);
+	for(int t=0; t<hough_width; t++)
+	{
+		cos_t[t] /= hough_params.rho_step;
+		sin_t[t] /= hough_params.rho_step;
+	}
+	errVal = cudaMalloc((void**)&devCos, hough_width*sizeof(float));
+	if( errVal != cudaSuccess)
+		{ printf("cudaMalloc error. %s\n",cudaGetErrorString(errVal)); exit(-1); }
+	errVal = cudaMalloc((void**)&devSin, hough_width*sizeof(float));
+	if( errVal != cudaSuccess)
+		{ printf("cudaMalloc error. %s\n",cudaGetErrorString(errVal)); exit(-1); }
+	cudaMemcpy(devCos, cos_t, hough_width*sizeof(float), cudaMemcpyHostToDevice);
+	cudaMemcpy(devSin, sin_t, hough_width*sizeof(float), cudaMemcpyHostToDevice);
+	free(cos_t);
+	free(sin_t);
 
 	// loop to allow for power measurement
 	do
@@ -207,15 +302,28 @@ void *CUDA_transform_thread(void * threadp)
 		start_time_d = timespec2double(start_time);
 
 ////////////////////////////////// BEGIN TRANSFORM ///////////////////////////////////
-		errVal = cudaMemcpy(devInImage, input_image, size*sizeof(u_char), cudaMemcpyHostToDevice);
-		if( errVal != cudaSuccess)
-			{ printf("cudaMemcpy1 error. %s\n",cudaGetErrorString(errVal)); exit(-1); }
-		
-		// Complete the Sobel transform to find edges
-		sobel_wrapper(devInImage, devTresholded, img_width, img_height, dimGrid, dimBlock);
+		if(use_canny)
+		{
+			// Thin the edges on the CPU and upload them as the 0/255 image the Hough kernel votes on
+			CPU_gradient(&grad, input_image);
+			CPU_canny(&canny, &grad, canny_low, edge_threshold, &edges);
+			edge_mask_to_image(&edges, edge_image);
+			errVal = cudaMemcpy(devTresholded, edge_image, size*sizeof(u_char), cudaMemcpyHostToDevice);
+			if( errVal != cudaSuccess)
+				{ printf("cudaMemcpy1 error. %s\n",cudaGetErrorString(errVal)); exit(-1); }
+		}
+		else
+		{
+			errVal = cudaMemcpy(devInImage, input_image, size*sizeof(u_char), cudaMemcpyHostToDevice);
+			if( errVal != cudaSuccess)
+				{ printf("cudaMemcpy1 error. %s\n",cudaGetErrorString(errVal)); exit(-1); }
+			
+			// Complete the Sobel transform to find edges
+			sobel_wrapper(devInImage, devTresholded, img_width, img_height, dimGrid, dimBlock);
+		}
 		
 		// Complete the Hough transform on the transformed sobel image
-		houghTransform_wrapper(devTresholded,  A, hough_h, dimGrid, dimBlock);
+		houghTransform_wrapper(devTresholded,  A, hough_h, devCos, devSin, hough_width, dimGrid, dimBlock);
 		
 		cudaThreadSynchronize();
 
@@ -272,9 +380,449 @@ void *CUDA_transform_thread(void * threadp)
 		elap_time_d = end_time_d - start_time_d;
 		printf("     Freq: %f Hz\n", 1000.0/elap_time_d);
 	} while(!run_once);
+	
+	// Every edge pixel of the last frame voted once per angle
+	errVal = cudaMemcpy(edge_image, devTresholded, size*sizeof(u_char), cudaMemcpyDeviceToHost);
+	if( errVal == cudaSuccess)
+	{
+		for(int i=0; i<size; i++)
+			edge_pixels += (edge_image[i] > 250);
+		printf("Hough votes: %lu (%lu edge pixels x %d angles)\n", edge_pixels*hough_width, edge_pixels, hough_width);
+	}
+	free(edge_image);
+	
+	if(use_canny)
+	{
+		workers_stop();
+		gradient_free(&grad);
+		canny_free(&canny);
+		edge_mask_free(&edges);
+	}
 
 	cudaFree(devInImage);
 	cudaFree(devTresholded);
+	cudaFree(devCos);
+	cudaFree(devSin);
+
+	return NULL; // to supress no return warnings.
+}
+
+//***************************************************************//
+// Clear the pixels the Sobel kernel never writes (x or y below 2,
+// last row and column) so the CPU votes on the same edges
+//***************************************************************//
+static void clear_sobel_border(edge_mask_t *mask)
+{
+	unsigned int w = mask->width, h = mask->height;
+	
+	for(unsigned int y=0; y<h; y++)
+	{
+		uint64_t *row = edge_mask_row(mask, y);
+		if(y < 2 || y+1 >= h)
+		{
+			memset(row, 0, sizeof(uint64_t) * mask->words_per_row);
+			continue;
+		}
+		row[0] &= ~(uint64_t)3;
+		row[(w-1) >> 6] &= ~((uint64_t)1 << ((w-1) & 63));
+	}
+}
+
+//***************************************************************//
+// Edge stage of the CPU transform: Canny, or the thresholded
+// gradient with the border the Sobel kernel leaves unwritten
+//***************************************************************//
+static void find_edges(gradient_t *grad, canny_t *canny, unsigned char *image, edge_mask_t *edges)
+{
+	CPU_gradient(grad, image);
+	if(use_canny)
+		CPU_canny(canny, grad, canny_low, edge_threshold, edges);
+	else
+	{
+		gradient_to_mask(grad, edges, gradient_threshold(GRAD_L1, edge_threshold));
+		clear_sobel_border(edges);
+	}
+}
+
+//***************************************************************//
+// Compare a probabilistic frame with the exhaustive transform of
+// the same edges: vote speedup and how far the leading peaks moved
+//***************************************************************//
+static void report_prob(hough_prob_t *prob, hough_t *hough, hough_t *hough_ref, hough_peaks_t *ref_peaks,
+                        const edge_mask_t *edges, const gradient_t *grad, double prob_time_d)
+{
+	struct timespec start_time, end_time;
+	double exhaustive_time_d;
+	float mean, worst;
+	
+	clock_gettime(CLOCK_REALTIME, &start_time);
+	CPU_hough(hough_ref, edges, grad);
+	clock_gettime(CLOCK_REALTIME, &end_time);
+	exhaustive_time_d = timespec2double(end_time) - timespec2double(start_time);
+	
+	CPU_hough_peaks(ref_peaks, hough_ref);
+	CPU_hough_peaks(&prob->peaks, hough);
+	mean = hough_peaks_distance(ref_peaks->peaks, ref_peaks->count, prob->peaks.peaks, prob->peaks.count, &worst);
+	printf("     Prob: %lu of %lu points after %d checkpoint(s), stopped on %s, vote speedup %.2fx, peaks moved %.2f bins (max %.2f)\n",
+		prob->sampled, hough->points, prob->checkpoints, prob->stop_reason,
+		(prob_time_d > 0.0) ? exhaustive_time_d / prob_time_d : 0.0, mean, worst);
+}
+
+//***************************************************************//
+// CPU transform thread
+//***************************************************************//
+void *CPU_transform_thread(void * threadp)
+{
+	// CPU transform local variables
+	struct timespec start_time, end_time, elap_time, diff_time;
+	double start_time_d, end_time_d, diff_time_d;
+	gradient_t grad;
+	canny_t canny;
+	edge_mask_t edges = {0, 0, 0, NULL};
+	hough_t hough;
+	hough_peaks_t peaks;
+	FILE *lines_fp = NULL;
+	bool lines_binary = false;
+	unsigned long frame = 0;
+	hough_prob_t prob;
+	hough_t hough_ref;
+	hough_peaks_t ref_peaks;
+	hough_segments_t segments;
+	hough_pyramid_t pyramid;
+	hough_incremental_t incremental;
+	hough_circles_t circles;
+	hough_fht_t fht;
+	hough_auto_t autosel;
+	FILE *auto_fp = NULL;
+	FILE *circles_fp = NULL;
+	canny_t pyramid_canny;
+	FILE *segments_fp = NULL;
+	bool segments_binary = false;
+	struct timespec vote_start, vote_end;
+	perf_counters_t counters;
+	perf_sample_t misses_start, misses_end;
+	double vote_time_d = 0.0, coarse_time_d = 0.0;
+	
+	if(num_threads > 1 && !workers_start(num_threads))
+		printf("Could not start worker threads, using a single thread.\n");
+	if(cache_stats && !perf_counters_open(&counters))
+		printf("Cache misses will not be counted (%s).\n", counters.reason);
+	
+	// Same parameter space as the kernel, the tables are built here once
+	if(!gradient_alloc(&grad, img_width, img_height, GRAD_L1,
+	                   (circle_count || hough_params.orient_window >= 0) ? HOUGH_ORIENT_BINS : use_canny ? CANNY_ORIENT_BINS : 0) ||
+	   !edge_mask_alloc(&edges, img_width, img_height) ||
+	   !hough_alloc(&hough, img_width, img_height, &hough_params, workers_count()))
+		{ printf("Could not allocate the Hough buffers.\n"); exit(EXIT_CPU_ERR); }
+	hough_height = hough.rho_bins;
+	hough_width = hough.theta_bins;
+	
+	// Circles replace the line vote, hough.pgm is then the centre accumulator
+	if(circle_count)
+	{
+		if(!hough_circles_alloc(&circles, img_width, img_height, circle_rmin, circle_rmax, circle_count,
+		                        circle_votes, circle_dist, workers_count()))
+			{ printf("Could not allocate the Hough circle buffers.\n"); exit(EXIT_CPU_ERR); }
+		circles_fp = fopen(circles_file.c_str(), "w");
+		if(circles_fp == NULL)
+			{ printf("Could not open %s.\n", circles_file.c_str()); exit(EXIT_CPU_ERR); }
+		hough_height = img_height;
+		hough_width = img_width;
+	}
+	
+	// Allocate memory for Hough output
+	result = (u_char*) malloc(hough_height*hough_width * sizeof(u_char));
+	if(result == NULL)
+		{ printf("malloc error.\n"); exit(-1); }
+	if(use_canny && !canny_alloc(&canny, img_width, img_height))
+		{ printf("Could not allocate the Canny buffers.\n"); exit(EXIT_CPU_ERR); }
+	
+	// Line list, binary when the name ends in ".bin"
+	if(peak_count)
+	{
+		if(!hough_peaks_alloc(&peaks, peak_count, peak_radius, peak_min, workers_count()))
+			{ printf("Could not allocate the Hough peaks.\n"); exit(EXIT_CPU_ERR); }
+		lines_binary = lines_file.size() > 4 && lines_file.compare(lines_file.size() - 4, 4, ".bin") == 0;
+		lines_fp = fopen(lines_file.c_str(), lines_binary ? "wb" : "w");
+		if(lines_fp == NULL)
+			{ printf("Could not open %s.\n", lines_file.c_str()); exit(EXIT_CPU_ERR); }
+	}
+	
+	// The probabilistic engine is checked against an exhaustive vote of the same frame
+	if(hough_engine == HOUGH_ENGINE_PROB)
+	{
+		if(!hough_prob_alloc(&prob, sample_fraction, vote_budget, random_seed, peak_radius, workers_count()) ||
+		   !hough_alloc(&hough_ref, img_width, img_height, &hough_params, workers_count()) ||
+		   !hough_peaks_alloc(&ref_peaks, HOUGH_PROB_PEAKS, peak_radius, 1, workers_count()))
+			{ printf("Could not allocate the probabilistic Hough buffers.\n"); exit(EXIT_CPU_ERR); }
+	}
+	
+	// Edges the accumulator was voted from, for the incremental update
+	if(use_incremental && !hough_incremental_alloc(&incremental, img_width, img_height, rebuild_every))
+		{ printf("Could not allocate the incremental Hough buffers.\n"); exit(EXIT_CPU_ERR); }
+	
+	// The coarse level has its own edge stage buffers
+	if(hough_engine == HOUGH_ENGINE_PYRAMID)
+	{
+		if(!hough_pyramid_alloc(&pyramid, img_width, img_height, &hough_params, pyramid_levels, pyramid_candidates,
+		                        pyramid_refine, peak_radius, use_canny ? CANNY_ORIENT_BINS : 0, workers_count()) ||
+		   (use_canny && !canny_alloc(&pyramid_canny, pyramid.width, pyramid.height)))
+			{ printf("Could not allocate the Hough pyramid.\n"); exit(EXIT_CPU_ERR); }
+	}
+	
+	// Engine picked per frame, calibrated on this frame size first if asked
+	if(hough_engine == HOUGH_ENGINE_AUTO)
+	{
+		if(!hough_auto_alloc(&autosel, auto_sparse, auto_dense, sample_fraction, vote_budget, random_seed, peak_radius,
+		                      workers_count()) ||
+		   (auto_calibrate && !hough_auto_calibrate(&autosel, &hough)))
+			{ printf("Could not allocate the automatic Hough engine.\n"); exit(EXIT_CPU_ERR); }
+		auto_fp = fopen(auto_log_file.c_str(), "w");
+		if(auto_fp == NULL)
+			{ printf("Could not open %s.\n", auto_log_file.c_str()); exit(EXIT_CPU_ERR); }
+		printf("Hough engine: direct up to %.3f%% edges, prob from %.3f%%, blocked in between\n",
+			autosel.sparse * 100.0f, autosel.dense * 100.0f);
+	}
+	
+	if(hough_engine == HOUGH_ENGINE_FHT && !hough_fht_alloc(&fht, img_width, img_height, hough.rho_bins, workers_count()))
+		{ printf("Could not allocate the FHT buffers.\n"); exit(EXIT_CPU_ERR); }
+	
+	// Segment list, binary when the name ends in ".bin" like the line list
+	if(hough_engine == HOUGH_ENGINE_PPHT)
+	{
+		if(!hough_segments_alloc(&segments, img_width, img_height, segment_votes, min_length, max_gap, random_seed))
+			{ printf("Could not allocate the Hough segment buffers.\n"); exit(EXIT_CPU_ERR); }
+		segments_binary = segments_file.size() > 4 && segments_file.compare(segments_file.size() - 4, 4, ".bin") == 0;
+		segments_fp = fopen(segments_file.c_str(), segments_binary ? "wb" : "w");
+		if(segments_fp == NULL)
+			{ printf("Could not open %s.\n", segments_file.c_str()); exit(EXIT_CPU_ERR); }
+	}
+
+	printf("Filtering started...\n");
+
+	// loop to allow for power measurement
+	do
+	{
+		// Get start of runtime timing
+		if(clock_gettime(CLOCK_REALTIME, &start_time) )
+		{
+		  printf("clock_gettime() - start - error.. exiting.\n");
+		  break;
+		}
+		start_time_d = timespec2double(start_time);
+
+////////////////////////////////// BEGIN TRANSFORM ///////////////////////////////////
+		find_edges(&grad, &canny, input_image, &edges);
+		
+		// Vote on the worker threads and saturate to 8 bits like the kernel's accumulator
+		if(cache_stats)
+			perf_counters_read(&counters, &misses_start);
+		clock_gettime(CLOCK_REALTIME, &vote_start);
+		if(circle_count)
+			CPU_hough_circles(&circles, &edges, &grad);
+		else if(hough_engine == HOUGH_ENGINE_PROB)
+			CPU_hough_prob(&prob, &hough, &edges, &grad);
+		else if(hough_engine == HOUGH_ENGINE_PPHT)
+			CPU_hough_segments(&segments, &hough, &edges);
+		else if(hough_engine == HOUGH_ENGINE_PYRAMID)
+		{
+			hough_pyramid_down(&pyramid, input_image);
+			find_edges(&pyramid.grad, &pyramid_canny, pyramid.images[pyramid.levels-1], &pyramid.edges);
+			clock_gettime(CLOCK_REALTIME, &vote_end);
+			coarse_time_d = timespec2double(vote_end) - timespec2double(vote_start);
+			CPU_hough_pyramid(&pyramid, &hough, &edges, &grad);
+		}
+		else if(hough_engine == HOUGH_ENGINE_FHT)
+			CPU_hough_fht(&fht, &hough, &edges);
+		else if(hough_engine == HOUGH_ENGINE_AUTO)
+			CPU_hough_auto(&autosel, &hough, &edges, &grad);
+		else if(use_incremental)
+			CPU_hough_incremental(&incremental, &hough, &edges);
+		else
+			CPU_hough(&hough, &edges, &grad);
+		clock_gettime(CLOCK_REALTIME, &vote_end);
+		vote_time_d = timespec2double(vote_end) - timespec2double(vote_start);
+		if(cache_stats)
+			perf_counters_read(&counters, &misses_end);
+		if(peak_count)
+			CPU_hough_peaks(&peaks, &hough);
+		if(write_accum && circle_count)
+			hough_circles_to_image(&circles, result);
+		else if(write_accum)
+			hough_to_image(&hough, result);
+
+#ifdef DEBUG
+		printf("DEBUG: End transform.\n");
+#endif
+////////////////////////////////// END TRANSFORM ///////////////////////////////////
+		// Get end of transform time timing
+		if(clock_gettime(CLOCK_REALTIME, &end_time) )
+		{
+		  printf("clock_gettime() - end - error.. exiting.\n");
+		  break;
+		}
+		
+		if(run_time.tv_nsec != 0)
+		{
+			// Calculate the timing for nanosleep
+			timespec_diff(&start_time, &end_time, &elap_time, true);
+			timespec_diff(&elap_time, &run_time, &diff_time, false);
+#ifdef DEBUG
+			end_time_d = timespec2double(end_time);
+			elap_time_d = end_time_d - start_time_d;
+			diff_time_d = timespec2double(diff_time);
+			printf("DEBUG: Transform runtime: %fms\n       Sleep time:       %fms\n",  elap_time_d, diff_time_d);
+#endif	
+			if(diff_time.tv_sec < 0 || diff_time.tv_nsec < 0)
+			{
+				diff_time_d = timespec2double(diff_time);
+				printf("TIME OVERRUN by %fms---------\n", -diff_time_d);  
+			} else
+			{
+				// Sleep for time needed to allow for running at known frequency 
+				int err = nanosleep(&diff_time, &end_time);			
+				if(err == -1)
+				{
+				   printf("\nFreq delay interrupted. Exiting..\n");
+				   printf("**%d - %s**\n", errno, strerror(errno));
+				   break;
+				}
+			}
+		}
+
+		// Get and calculate end of runtime time
+		if(clock_gettime(CLOCK_REALTIME, &end_time) )
+		{
+		  printf("clock_gettime() - end - error.. exiting.\n");
+		  break;
+		}
+		end_time_d = timespec2double(end_time);
+		elap_time_d = end_time_d - start_time_d;
+		printf("     Freq: %f Hz (%.0f px/s, %lu votes on %d thread(s))\n", 1000.0/elap_time_d,
+			(double)img_width*img_height*1000.0/elap_time_d, circle_count ? circles.votes : hough.votes, workers_count());
+		
+		// A few bytes per line, outside the timed transform
+		if(peak_count)
+			hough_peaks_write(&peaks, lines_fp, lines_binary, frame);
+		if(hough_engine == HOUGH_ENGINE_PROB)
+			report_prob(&prob, &hough, &hough_ref, &ref_peaks, &edges, &grad, vote_time_d);
+		if(hough_engine == HOUGH_ENGINE_PPHT)
+		{
+			hough_segments_write(&segments, segments_fp, segments_binary, frame);
+			printf("     Segments: %d, %lu of %lu points voted, %lu consumed by walks\n",
+				segments.count, segments.visited, segments.points, segments.consumed);
+		}
+		if(use_incremental)
+			printf("     Incremental: +%lu -%lu of %lu edge pixels%s\n", incremental.added_count, incremental.removed_count,
+				incremental.points, incremental.rebuilt ? ", full rebuild" : "");
+		if(hough_engine == HOUGH_ENGINE_PYRAMID)
+			printf("     Pyramid: %d candidate(s) from %lu points at 1/%d scale, %lu of %lu points refined, pyrdown and coarse edges %.2fms, votes %.2fms\n",
+				pyramid.candidates.count, pyramid.coarse.points, 1 << pyramid.levels, pyramid.refined, hough.points,
+				coarse_time_d, vote_time_d - coarse_time_d);
+		if(hough_engine == HOUGH_ENGINE_AUTO)
+		{
+			hough_auto_write(&autosel, auto_fp, frame, vote_time_d);
+			printf("     Auto: %lu edge pixels (%.3f%%), %s engine, votes %.2fms\n", autosel.edges,
+				autosel.density * 100.0f, hough_auto_name(autosel.choice), vote_time_d);
+		}
+		if(hough_engine == HOUGH_ENGINE_FHT)
+			printf("     FHT: %lu sums for %lu edge pixels, %.2fms\n", fht.sums, hough.points, vote_time_d);
+		if(cache_stats && counters.available)
+			printf("     Cache: %llu L1D read misses, %llu LLC misses in the vote stage (%s layout), %.2fms\n",
+				misses_end.l1d_misses - misses_start.l1d_misses, misses_end.llc_misses - misses_start.llc_misses,
+				hough.tiled ? "tiled" : "blocked", vote_time_d);
+		if(circle_count)
+		{
+			hough_circles_write(&circles, circles_fp, frame);
+			printf("     Circles: %d of %d centre candidate(s) from %lu edge pixels, votes %.2fms\n",
+				circles.count, circles.candidate_count, circles.points, vote_time_d);
+		}
+		frame++;
+	} while(!run_once);
+	
+	if(circle_count)
+		printf("Hough votes: %lu (%lu edge pixels x up to %d centres)\n", circles.votes, circles.points,
+			2 * (circles.rmax - circles.rmin + 1));
+	else if(hough_engine == HOUGH_ENGINE_PROB)
+		printf("Hough votes: %lu (%lu of %lu edge pixels sampled)\n", hough.votes, prob.sampled, hough.points);
+	else if(hough_engine == HOUGH_ENGINE_PPHT)
+		printf("Hough votes: %lu (%lu of %lu edge pixels x %d angles)\n", hough.votes, segments.visited, hough.points, hough.theta_bins);
+	else if(hough_engine == HOUGH_ENGINE_PYRAMID)
+		printf("Hough votes: %lu (%lu coarse, %lu in +/-%d rho x +/-%d theta bin windows)\n", hough.votes,
+			pyramid.coarse.votes, pyramid.votes, pyramid.rho_window, pyramid.theta_window);
+	else if(hough_engine == HOUGH_ENGINE_AUTO)
+		printf("Hough votes: %lu (%lu edge pixels, last frame on the %s engine)\n", hough.votes, hough.points,
+			hough_auto_name(autosel.choice));
+	else if(hough_engine == HOUGH_ENGINE_FHT)
+		printf("Hough votes: %lu (dyadic line sums over %d x %d and %d x %d rows, %lu edge pixels)\n", hough.votes,
+			fht.rows[0], fht.cols[0], fht.rows[2], fht.cols[2], hough.points);
+	else if(use_incremental && !incremental.rebuilt)
+		printf("Hough votes: %lu (%lu changed edge pixels x %d angles)\n", hough.votes, hough.points, hough.theta_bins);
+	else if(hough.windowed)
+		printf("Hough votes: %lu (%lu edge pixels within +/-%d of %d angles)\n", hough.votes, hough.points, hough_params.orient_window, hough.theta_bins);
+	else
+		printf("Hough votes: %lu (%lu edge pixels x %d angles)\n", hough.votes, hough.points, hough.theta_bins);
+	
+	if(peak_count)
+	{
+		printf("Hough peaks: %d line(s) per frame written to %s", peaks.count, lines_file.c_str());
+		if(peaks.count)
+			printf(", strongest rho %.1f theta %.1f (%u votes)", peaks.peaks[0].rho, peaks.peaks[0].theta, peaks.peaks[0].votes);
+		printf("\n");
+		fclose(lines_fp);
+		hough_peaks_free(&peaks);
+	}
+	if(!sparse_file.empty())
+		hough_sparse_dump(&hough, peak_min, sparse_file);
+	if(hough_engine == HOUGH_ENGINE_PROB)
+	{
+		hough_prob_free(&prob);
+		hough_free(&hough_ref);
+		hough_peaks_free(&ref_peaks);
+	}
+	if(use_incremental)
+		hough_incremental_free(&incremental);
+	if(hough_engine == HOUGH_ENGINE_FHT)
+		hough_fht_free(&fht);
+	if(hough_engine == HOUGH_ENGINE_AUTO)
+	{
+		printf("Hough engines: %lu frame(s) direct, %lu blocked, %lu prob, choices written to %s\n",
+			autosel.picked[HOUGH_AUTO_DIRECT], autosel.picked[HOUGH_AUTO_BLOCKED], autosel.picked[HOUGH_AUTO_PROB],
+			auto_log_file.c_str());
+		fclose(auto_fp);
+		hough_auto_free(&autosel);
+	}
+	if(hough_engine == HOUGH_ENGINE_PYRAMID)
+	{
+		hough_pyramid_free(&pyramid);
+		if(use_canny)
+			canny_free(&pyramid_canny);
+	}
+	if(hough_engine == HOUGH_ENGINE_PPHT)
+	{
+		printf("Hough segments: %d per frame written to %s\n", segments.count, segments_file.c_str());
+		fclose(segments_fp);
+		hough_segments_free(&segments);
+	}
+	if(circle_count)
+	{
+		printf("Hough circles: %d per frame written to %s", circles.count, circles_file.c_str());
+		if(circles.count)
+			printf(", strongest at (%d, %d) r %d (%u votes)", circles.circles[0].x, circles.circles[0].y,
+				circles.circles[0].r, circles.circles[0].votes);
+		printf("\n");
+		fclose(circles_fp);
+		hough_circles_free(&circles);
+	}
+	
+	if(cache_stats)
+		perf_counters_close(&counters);
+	workers_stop();
+	gradient_free(&grad);
+	edge_mask_free(&edges);
+	hough_free(&hough);
+	if(use_canny)
+		canny_free(&canny);
 
 	return NULL; // to supress no return warnings.
 }
@@ -296,7 +844,7 @@ int main(int argc, char* argv[])
 	// Check input
 	if(options.has("help") || options.has("h") || options.has("?")) 
 	{
-		std::cout << "Usage: " << argv[0] << " [-continuous [-fps=FPS]] [-img=imageFilename] [-cuda] " << std::endl;
+		std::cout << "Usage: " << argv[0] << " [-continuous [-fps=FPS]] [-img=imageFilename] [-cuda] [-threads=N] [-canny [-threshold=T] [-canny-low=T]] [-theta-min=DEG] [-theta-max=DEG] [-theta-step=DEG] [-rho-step=PX] [-orient-window=K] [-layout=blocked|tiled] [-cache-stats] [-peaks=K [-peak-radius=R] [-peak-min=N] [-lines=file.txt|file.bin]] [-sparse=file] [-noaccum] [-engine=blocked|prob|ppht|pyramid|fht|auto] [-auto-sparse=F] [-auto-dense=F] [-calibrate] [-auto-log=file] [-sample-fraction=F] [-vote-budget=N] [-segments=file.txt|file.bin] [-segment-votes=N] [-min-length=PX] [-max-gap=PX] [-seed=S] [-levels=N] [-candidates=K] [-refine=N] [-incremental [-rebuild-every=N]] [-circles=K [-rmin=PX] [-rmax=PX] [-circle-votes=N] [-circle-dist=PX] [-circle-list=file]]" << std::endl;
 		exit(EXIT_SUCCESS);
 	}
 	
@@ -342,13 +890,223 @@ int main(int argc, char* argv[])
 		wait = false;
 		std::cout << "Program will not wait for acknowledgement" << std::endl;
 	}
+	
+	if(options.has("canny"))
+	{
+		use_canny = true;
+		if(options.has("threshold"))
+			edge_threshold = options.get<int>("threshold");
+		edge_threshold = (edge_threshold < 1) ? 1 : edge_threshold;
+		canny_low = options.has("canny-low") ? options.get<int>("canny-low") : edge_threshold/2;
+		canny_low = (canny_low < 1) ? 1 : (canny_low > edge_threshold) ? edge_threshold : canny_low;
+		std::cout << "Edges will be thinned with Canny on the CPU (low " << canny_low << ", high " << edge_threshold << ")" << std::endl;
+	}
+	
+	hough_params_default(&hough_params);
+	if(options.has("theta-min"))
+		hough_params.theta_min = options.get<float>("theta-min");
+	if(options.has("theta-max"))
+		hough_params.theta_max = options.get<float>("theta-max");
+	if(options.has("theta-step"))
+		hough_params.theta_step = options.get<float>("theta-step");
+	if(options.has("rho-step"))
+		hough_params.rho_step = options.get<float>("rho-step");
+	if(options.has("orient-window"))
+	{
+		if(use_cuda)
+			std::cout << "The orientation window is CPU only, ignored with -cuda" << std::endl;
+		else
+			hough_params.orient_window = options.get<int>("orient-window");
+	}
+	if(options.has("layout"))
+	{
+		if(use_cuda)
+			std::cout << "The accumulator layout is CPU only, ignored with -cuda" << std::endl;
+		else if(!hough_parse_layout(options.get<std::string>("layout").c_str(), &hough_params.layout))
+			std::cout << "Unknown accumulator layout " << options.get<std::string>("layout") << ", using blocked" << std::endl;
+		else if(hough_params.layout == HOUGH_LAYOUT_TILED && hough_params.orient_window >= 0)
+			std::cout << "The tiled layout votes every angle, the orientation window uses the blocked one" << std::endl;
+		else if(hough_params.layout == HOUGH_LAYOUT_TILED)
+			std::cout << "Worker accumulators will be theta-major tiles, transposed when merged" << std::endl;
+	}
+	if(!hough_params_valid(&hough_params))
+	{
+		printf("Using the default Hough space.\n");
+		hough_params_default(&hough_params);
+	}
+	std::cout << "Hough space: theta " << hough_params.theta_min << " to " << hough_params.theta_max << " step " << hough_params.theta_step
+		<< " degrees, rho step " << hough_params.rho_step << " px" << std::endl;
+	if(hough_params.orient_window >= 0)
+		std::cout << "Edge pixels vote within " << hough_params.orient_window << " theta bins of their gradient orientation" << std::endl;
+	
+	if(options.has("peaks") || options.has("sparse"))
+	{
+		if(options.has("peak-radius"))
+			peak_radius = (options.get<int>("peak-radius") < 1) ? 1 : options.get<int>("peak-radius");
+		if(options.has("peak-min"))
+			peak_min = (options.get<int>("peak-min") < 1) ? 1 : options.get<int>("peak-min");
+		if(options.has("lines"))
+			lines_file = options.get<std::string>("lines");
+		if(options.has("sparse"))
+			sparse_file = options.get<std::string>("sparse");
+		if(use_cuda)
+			std::cout << "Peak extraction is CPU only, ignored with -cuda" << std::endl;
+		else if(options.has("peaks"))
+		{
+			peak_count = (options.get<int>("peaks") < 1) ? 1 : options.get<int>("peaks");
+			std::cout << "Top " << peak_count << " lines (NMS radius " << peak_radius << ", at least " << peak_min
+				<< " votes) will be written to " << lines_file << std::endl;
+		}
+	}
+	if(options.has("engine"))
+	{
+		hough_engine_t engine;
+		if(!hough_parse_engine(options.get<std::string>("engine").c_str(), &engine))
+			std::cout << "Unknown Hough engine " << options.get<std::string>("engine") << ", using blocked" << std::endl;
+		else if(use_cuda && engine != HOUGH_ENGINE_BLOCKED)
+			std::cout << "Hough engines are CPU only, ignored with -cuda" << std::endl;
+		else
+			hough_engine = engine;
+	}
+	if(hough_engine == HOUGH_ENGINE_PROB)
+	{
+		if(options.has("sample-fraction"))
+			sample_fraction = options.get<float>("sample-fraction");
+		if(options.has("vote-budget"))
+			vote_budget = options.get<unsigned long>("vote-budget");
+		if(options.has("seed"))
+			random_seed = options.get<unsigned int>("seed");
+		std::cout << "Probabilistic Hough: at most " << sample_fraction*100 << "% of the points";
+		if(vote_budget)
+			std::cout << " and " << vote_budget << " votes";
+		std::cout << ", seed " << random_seed << std::endl;
+	}
+	if(hough_engine == HOUGH_ENGINE_AUTO)
+	{
+		// The sampling engine only takes the densest frames, so it samples harder
+		sample_fraction = options.has("sample-fraction") ? options.get<float>("sample-fraction") : HOUGH_AUTO_SAMPLE;
+		if(options.has("vote-budget"))
+			vote_budget = options.get<unsigned long>("vote-budget");
+		if(options.has("seed"))
+			random_seed = options.get<unsigned int>("seed");
+		if(options.has("auto-sparse"))
+			auto_sparse = options.get<float>("auto-sparse");
+		if(options.has("auto-dense"))
+			auto_dense = options.get<float>("auto-dense");
+		if(options.has("auto-log"))
+			auto_log_file = options.get<std::string>("auto-log");
+		auto_calibrate = options.has("calibrate");
+		std::cout << "Automatic Hough engine: " << (auto_calibrate ? "calibrated crossovers" : "default crossovers")
+			<< ", dense frames sample " << sample_fraction*100 << "% of the points, choices logged to " << auto_log_file << std::endl;
+	}
+	if(hough_engine == HOUGH_ENGINE_PYRAMID)
+	{
+		if(options.has("levels"))
+			pyramid_levels = options.get<int>("levels");
+		if(options.has("candidates"))
+			pyramid_candidates = (options.get<int>("candidates") < 1) ? 1 : options.get<int>("candidates");
+		if(options.has("refine"))
+			pyramid_refine = options.get<int>("refine");
+		pyramid_levels = (pyramid_levels < 1) ? 1 : (pyramid_levels > HOUGH_PYRAMID_LEVELS) ? HOUGH_PYRAMID_LEVELS : pyramid_levels;
+		std::cout << "Coarse-to-fine Hough: " << pyramid_candidates << " candidate(s) found " << pyramid_levels
+			<< " pyramid level(s) down, refined +/-" << pyramid_refine << " coarse bins" << std::endl;
+	}
+	if(hough_engine == HOUGH_ENGINE_FHT)
+	{
+		if(hough_params.orient_window >= 0)
+			std::cout << "The orientation window is not used by the FHT" << std::endl;
+		std::cout << "Fast Hough Transform: every dyadic line is summed, the frame time does not depend on the edge count" << std::endl;
+	}
+	if(hough_engine == HOUGH_ENGINE_PPHT)
+	{
+		if(options.has("segments"))
+			segments_file = options.get<std::string>("segments");
+		if(options.has("segment-votes"))
+			segment_votes = options.get<int>("segment-votes");
+		if(options.has("min-length"))
+			min_length = options.get<int>("min-length");
+		if(options.has("max-gap"))
+			max_gap = options.get<int>("max-gap");
+		if(options.has("seed"))
+			random_seed = options.get<unsigned int>("seed");
+		if(hough_params.orient_window >= 0)
+			std::cout << "The orientation window is not used by the segment detector" << std::endl;
+		std::cout << "Segments of at least " << min_length << " px with gaps up to " << max_gap << " px, walked at "
+			<< segment_votes << " votes, will be written to " << segments_file << ", seed " << random_seed << std::endl;
+	}
+	
+	if(options.has("incremental"))
+	{
+		if(use_cuda || hough_engine != HOUGH_ENGINE_BLOCKED || hough_params.orient_window >= 0)
+			std::cout << "Incremental mode only applies to the blocked CPU engine without an orientation window, ignoring -incremental" << std::endl;
+		else
+		{
+			use_incremental = true;
+			if(options.has("rebuild-every"))
+				rebuild_every = (options.get<int>("rebuild-every") < 0) ? 0 : options.get<int>("rebuild-every");
+			std::cout << "CPU Hough will only vote edge pixels that changed, with a full rebuild every " << rebuild_every << " frame(s)" << std::endl;
+		}
+	}
+	
+	if(options.has("circles"))
+	{
+		if(use_cuda)
+			std::cout << "Circle detection is CPU only, ignored with -cuda" << std::endl;
+		else
+		{
+			circle_count = (options.get<int>("circles") < 1) ? 1 : options.get<int>("circles");
+			if(options.has("rmin"))
+				circle_rmin = (options.get<int>("rmin") < 1) ? 1 : options.get<int>("rmin");
+			if(options.has("rmax"))
+				circle_rmax = options.get<int>("rmax");
+			circle_rmax = (circle_rmax < circle_rmin) ? circle_rmin : circle_rmax;
+			if(options.has("circle-votes"))
+				circle_votes = (options.get<int>("circle-votes") < 1) ? 1 : options.get<int>("circle-votes");
+			circle_dist = options.has("circle-dist") ? options.get<int>("circle-dist") : circle_rmin;
+			if(options.has("circle-list"))
+				circles_file = options.get<std::string>("circle-list");
+			if(peak_count || !sparse_file.empty() || hough_engine != HOUGH_ENGINE_BLOCKED || use_incremental)
+			{
+				std::cout << "Circle mode replaces the line transform, ignoring the line engine, peak and incremental options" << std::endl;
+				peak_count = 0;
+				sparse_file = "";
+				hough_engine = HOUGH_ENGINE_BLOCKED;
+				use_incremental = false;
+			}
+			std::cout << "Up to " << circle_count << " circle(s) of radius " << circle_rmin << " to " << circle_rmax << " px, at least "
+				<< circle_votes << " votes and " << circle_dist << " px apart, will be written to " << circles_file << std::endl;
+		}
+	}
+	
+	if(options.has("cache-stats"))
+	{
+		if(use_cuda)
+			std::cout << "Cache miss counts are CPU only, ignored with -cuda" << std::endl;
+		else
+		{
+			cache_stats = true;
+			std::cout << "Cache misses of the vote stage will be counted with perf_event_open" << std::endl;
+		}
+	}
+	
+	if(options.has("noaccum"))
+	{
+		write_accum = false;
+		std::cout << "The accumulator image will not be written" << std::endl;
+	}
+	
+	if(options.has("threads"))
+	{
+		num_threads = (options.get<int>("threads") < 1) ? 1 : options.get<int>("threads");
+		std::cout << "CPU stages will use " << num_threads << " thread(s)" << std::endl;
+	}
 
 #ifdef DEBUG
 	printf("DEBUG: Begin Program. \n");
 #endif	
 	
-	// Initialize CUDA
-	if(!InitCUDA()) {
+	// Initialize CUDA, the CPU transform runs on nodes without a GPU
+	if(use_cuda && !InitCUDA()) {
 		exit(EXIT_UNKOWN_ERROR);
 	};
 	
@@ -368,7 +1126,7 @@ int main(int argc, char* argv[])
 		exit(EXIT_IMG_SZ);
 	}
 
-	input_image = (unsigned char *)malloc(sizeof(unsigned int) * img_width * img_height);
+	input_image = (unsigned char *)malloc(sizeof(unsigned char) * img_width * img_height * img_chan);
 	readppm(input_image, &tempInt, 
              tempChar, &tempInt,
              &img_height, &img_width, &img_chan,
@@ -421,7 +1179,11 @@ int main(int argc, char* argv[])
 	}
 	else // Use CPU version for transform
     {
-		printf("No CPU version of Hough transform available. Please use CUDA by specifying '-cuda' in program call.\n");
+		pthread_create(&rt_thread,   	// pointer to thread descriptor
+			NULL,     		// use default attributes
+			CPU_transform_thread,	// thread function entry point
+			&rt_param 		// parameters to pass in
+			);
 	}	
 	
 	// Let transform thread run
@@ -430,14 +1192,16 @@ int main(int argc, char* argv[])
 	pthread_join(rt_thread, NULL);
 	
 	// Writeback results
-	dump_ppm_data("hough.pgm", hough_width, hough_height, img_chan, result);
+	if(write_accum)
+		dump_ppm_data("hough.pgm", hough_width, hough_height, img_chan, result);
 	
 	// Free memory
 	free(input_image);
 	free(result);
 
 	// Close CUDA
-	cudaThreadExit();
+	if(use_cuda)
+		cudaThreadExit();
 
 	if( run_once && !wait ) // usually only in testing, so output speed of transform to file
 	{
@@ -0,0 +1,168 @@
+//*****************************************************************************************//
+//  hough_auto.cpp - Edge density adaptive choice of CPU Hough engine (-engine=auto)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "hough_auto.h"
+
+#define CALIBRATION_DENSITIES	9
+
+// Edge fractions timed by the calibration
+static const float calibration_densities[CALIBRATION_DENSITIES] =
+	{ 0.0005f, 0.001f, 0.002f, 0.005f, 0.01f, 0.02f, 0.05f, 0.1f, 0.2f };
+
+static const char *choice_names[HOUGH_AUTO_CHOICES] = { "direct", "blocked", "prob" };
+
+bool hough_auto_alloc(hough_auto_t *au, float sparse, float dense, float sample_fraction,
+                      unsigned long vote_budget, unsigned int seed, int peak_radius, int workers)
+{
+	memset(au, 0, sizeof(hough_auto_t));
+	au->sparse = (sparse < 0.0f) ? 0.0f : sparse;
+	au->dense = (dense < au->sparse) ? au->sparse : dense;
+	au->seed = seed;
+	return hough_prob_alloc(&au->prob, sample_fraction, vote_budget, seed, peak_radius, workers);
+}
+
+void hough_auto_free(hough_auto_t *au)
+{
+	hough_prob_free(&au->prob);
+}
+
+const char *hough_auto_name(hough_auto_choice_t choice)
+{
+	return (choice < HOUGH_AUTO_CHOICES) ? choice_names[choice] : "unknown";
+}
+
+static void hough_auto_run(hough_auto_t *au, hough_t *hough, const edge_mask_t *edges, const gradient_t *grad,
+                           hough_auto_choice_t choice)
+{
+	switch(choice)
+	{
+	case HOUGH_AUTO_DIRECT:
+		CPU_hough_direct(hough, edges);
+		break;
+	case HOUGH_AUTO_PROB:
+		CPU_hough_prob(&au->prob, hough, edges, grad);
+		break;
+	default:
+		CPU_hough(hough, edges, grad);
+		break;
+	}
+}
+
+void CPU_hough_auto(hough_auto_t *au, hough_t *hough, const edge_mask_t *edges, const gradient_t *grad)
+{
+	au->edges = edge_mask_count(edges);
+	au->density = (float)au->edges / ((float)edges->width * edges->height);
+	if(au->density >= au->dense)
+		au->choice = HOUGH_AUTO_PROB;
+	else if(au->density <= au->sparse && !hough->windowed)
+		au->choice = HOUGH_AUTO_DIRECT;
+	else
+		au->choice = HOUGH_AUTO_BLOCKED;
+	au->picked[au->choice]++;
+	hough_auto_run(au, hough, edges, grad, au->choice);
+}
+
+//***************************************************************//
+// Fastest of HOUGH_AUTO_RUNS runs of one engine, in ms
+//***************************************************************//
+static double hough_auto_time(hough_auto_t *au, hough_t *hough, const edge_mask_t *edges, hough_auto_choice_t choice)
+{
+	double best = 0.0;
+	
+	for(int run=0; run<HOUGH_AUTO_RUNS; run++)
+	{
+		struct timespec start, end;
+		double ms;
+		
+		clock_gettime(CLOCK_REALTIME, &start);
+		hough_auto_run(au, hough, edges, NULL, choice);
+		clock_gettime(CLOCK_REALTIME, &end);
+		ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+		if(run == 0 || ms < best)
+			best = ms;
+	}
+	return best;
+}
+
+//***************************************************************//
+// Crossover between two grid densities, geometric so it does not
+// lean toward the coarser end of the grid
+//***************************************************************//
+static float crossover(int k)
+{
+	return (k == 0) ? calibration_densities[0] : sqrtf(calibration_densities[k-1] * calibration_densities[k]);
+}
+
+bool hough_auto_calibrate(hough_auto_t *au, hough_t *hough)
+{
+	double times[CALIBRATION_DENSITIES][HOUGH_AUTO_CHOICES];
+	unsigned long pixels = (unsigned long)hough->width * hough->height;
+	uint64_t state = hough_random_seed(au->seed);
+	int sparse_k = CALIBRATION_DENSITIES, dense_k = CALIBRATION_DENSITIES;
+	edge_mask_t mask;
+	
+	// The orientation window needs a gradient, random masks have none
+	if(hough->windowed)
+	{
+		printf("The Hough engines cannot be calibrated with an orientation window, keeping the default crossovers.\n");
+		return true;
+	}
+	if(!edge_mask_alloc(&mask, hough->width, hough->height))
+		return false;
+	
+	printf("Hough engine calibration on %d x %d, %d worker(s), fastest of %d runs:\n", hough->width, hough->height,
+		hough->workers, HOUGH_AUTO_RUNS);
+	printf("   edges    direct   blocked      prob\n");
+	for(int k=0; k<CALIBRATION_DENSITIES; k++)
+	{
+		unsigned long n = (unsigned long)(calibration_densities[k] * pixels);
+		
+		// Uniform random edges, a few land twice
+		edge_mask_clear(&mask);
+		for(unsigned long i=0; i<n; i++)
+		{
+			unsigned long p = (unsigned long)(((hough_random(&state) >> 32) * (uint64_t)pixels) >> 32);
+			edge_mask_set(&mask, p % hough->width, p / hough->width);
+		}
+		for(int c=0; c<HOUGH_AUTO_CHOICES; c++)
+			times[k][c] = hough_auto_time(au, hough, &mask, (hough_auto_choice_t)c);
+		printf("  %5.2f%%  %6.2fms  %6.2fms  %6.2fms\n", calibration_densities[k] * 100.0f,
+			times[k][HOUGH_AUTO_DIRECT], times[k][HOUGH_AUTO_BLOCKED], times[k][HOUGH_AUTO_PROB]);
+		
+		if(sparse_k == CALIBRATION_DENSITIES && times[k][HOUGH_AUTO_BLOCKED] <= times[k][HOUGH_AUTO_DIRECT])
+			sparse_k = k;
+		if(dense_k == CALIBRATION_DENSITIES && times[k][HOUGH_AUTO_PROB] < times[k][HOUGH_AUTO_BLOCKED] &&
+		   times[k][HOUGH_AUTO_PROB] < times[k][HOUGH_AUTO_DIRECT])
+			dense_k = k;
+	}
+	edge_mask_free(&mask);
+	
+	// Prob from where it beats both, but sampling loses lines so never below the
+	// dense crossover asked for; direct up to where blocked catches it
+	if(dense_k == CALIBRATION_DENSITIES)
+		au->dense = 1.0f;
+	else if(crossover(dense_k) > au->dense)
+		au->dense = crossover(dense_k);
+	au->sparse = (sparse_k == CALIBRATION_DENSITIES) ? calibration_densities[CALIBRATION_DENSITIES-1] : crossover(sparse_k);
+	if(au->sparse > au->dense)
+		au->sparse = au->dense;
+	
+	// The runs above drew from the sampling engine, frames start from the seed again
+	au->prob.state = hough_random_seed(au->seed);
+	return true;
+}
+
+void hough_auto_write(const hough_auto_t *au, FILE *fp, unsigned long frame, double vote_ms)
+{
+	fprintf(fp, "%lu %lu %.6f %s %.3f\n", frame, au->edges, au->density, hough_auto_name(au->choice), vote_ms);
+}
@@ -0,0 +1,78 @@
+//*****************************************************************************************//
+//  hough_auto.h - Edge density adaptive choice of CPU Hough engine (-engine=auto)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	Which engine is fastest depends on how many pixels pass the edge threshold. With
+//	few edges the frame is mostly the fixed cost of clearing and summing the per worker
+//	accumulators, so the points are voted straight into acc (CPU_hough_direct). In
+//	between the blocked engine wins (CPU_hough). With many edges a random sample of
+//	them is voted (CPU_hough_prob, sample_fraction of the points at most).
+//
+//	Every frame the set pixels of the edge mask are counted with popcount and their
+//	fraction of the image compared with the two crossovers, sparse and dense. The
+//	defaults were measured on the development machine; hough_auto_calibrate() times
+//	the three engines on random masks of the frame size with the running workers and
+//	moves them to where the engines actually meet on this one, except that the dense
+//	crossover is only ever raised: a sample can win well below it, but it loses
+//	the weaker lines, which only pays on dense frames. The choice of every
+//	frame can be written to a log, one "frame edges density engine ms" line per frame.
+//
+//	With an orientation window the direct engine is not available and the blocked
+//	one is used below the dense crossover.
+//
+//*****************************************************************************************//
+#ifndef HOUGH_AUTO_H
+#define HOUGH_AUTO_H
+
+#include <stdio.h>
+
+#include "edgemask.h"
+#include "gradient.h"
+#include "hough_cpu.h"
+#include "hough_prob.h"
+
+#define HOUGH_AUTO_SPARSE	0.002f	// edge fraction up to which points are voted directly
+#define HOUGH_AUTO_DENSE	0.05f	// and from which a sample is voted
+#define HOUGH_AUTO_SAMPLE	0.25f	// sample fraction when -sample-fraction is not given
+#define HOUGH_AUTO_RUNS		3		// calibration runs per engine and density, the fastest counts
+
+typedef enum
+{
+	HOUGH_AUTO_DIRECT,		// CPU_hough_direct
+	HOUGH_AUTO_BLOCKED,		// CPU_hough
+	HOUGH_AUTO_PROB,		// CPU_hough_prob
+	HOUGH_AUTO_CHOICES
+} hough_auto_choice_t;
+
+typedef struct
+{
+	float sparse;			// crossovers, fractions of the image
+	float dense;
+	unsigned int seed;		// of the sampling engine, restored after calibration
+	hough_prob_t prob;
+	unsigned long edges;	// set pixels of the current frame
+	float density;
+	hough_auto_choice_t choice;
+	unsigned long picked[HOUGH_AUTO_CHOICES];	// frames run on each engine
+} hough_auto_t;
+
+// Allocate for workers threads, with the crossovers and the sampling engine's settings
+bool hough_auto_alloc(hough_auto_t *au, float sparse, float dense, float sample_fraction,
+                      unsigned long vote_budget, unsigned int seed, int peak_radius, int workers);
+void hough_auto_free(hough_auto_t *au);
+
+// Time the engines on random masks of hough's image size, print the table and move
+// the crossovers to where the engines meet. Returns false if it could not allocate.
+bool hough_auto_calibrate(hough_auto_t *au, hough_t *hough);
+
+// Count the edges, pick the engine and vote with it into hough->acc
+void CPU_hough_auto(hough_auto_t *au, hough_t *hough, const edge_mask_t *edges, const gradient_t *grad);
+
+// "direct", "blocked" or "prob"
+const char *hough_auto_name(hough_auto_choice_t choice);
+
+// Append the choice of one frame to an open log
+void hough_auto_write(const hough_auto_t *au, FILE *fp, unsigned long frame, double vote_ms);
+
+#endif
@@ -0,0 +1,394 @@
+//*****************************************************************************************//
+//  hough_circles.cpp - Gradient voting CPU Hough circle detector (-circles)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hough_circles.h"
+#include "hough_cpu.h"
+#include "workers.h"
+
+#define MAXRGB		255
+#define WALK_SHIFT	16			// fixed point fraction bits of the centre walk
+#define ALIGN_MIN	0.9f		// |cos| between a pixel's gradient and the way to the centre
+
+bool hough_circles_alloc(hough_circles_t *circ, int width, int height, int rmin, int rmax, int max_circles,
+                         unsigned int min_votes, int min_dist, int workers)
+{
+	unsigned long cells = (unsigned long)width * height;
+	int cap;
+	
+	memset(circ, 0, sizeof(hough_circles_t));
+	circ->width = width;
+	circ->height = height;
+	circ->rmin = (rmin < 1) ? 1 : rmin;
+	circ->rmax = (rmax < circ->rmin) ? circ->rmin : rmax;
+	circ->max_circles = (max_circles < 1) ? 1 : max_circles;
+	circ->min_votes = (min_votes < 1) ? 1 : min_votes;
+	circ->min_dist = (min_dist < 1) ? 1 : min_dist;
+	circ->workers = (workers < 1) ? 1 : workers;
+	cap = circ->max_circles * HOUGH_CIRCLE_SPREAD;
+	
+	circ->acc = (unsigned int *)malloc(sizeof(unsigned int) * cells);
+	circ->candidates = (hough_circle_t *)malloc(sizeof(hough_circle_t) * cap * circ->workers);
+	circ->candidate_counts = (int *)calloc(circ->workers, sizeof(int));
+	circ->band_votes = (unsigned long *)calloc(circ->workers, sizeof(unsigned long));
+	circ->hists = (unsigned int *)malloc(sizeof(unsigned int) * (circ->rmax + 2) * cap);
+	circ->circles = (hough_circle_t *)malloc(sizeof(hough_circle_t) * circ->max_circles);
+	if(!circ->acc || !circ->candidates ||
+	   !circ->candidate_counts || !circ->band_votes || !circ->hists || !circ->circles)
+	{
+		hough_circles_free(circ);
+		return false;
+	}
+	return true;
+}
+
+void hough_circles_free(hough_circles_t *circ)
+{
+	free(circ->acc);
+	free(circ->xs);
+	free(circ->ys);
+	free(circ->bins);
+	free(circ->candidates);
+	free(circ->candidate_counts);
+	free(circ->band_votes);
+	free(circ->hists);
+	free(circ->circles);
+	circ->acc = circ->hists = NULL;
+	circ->xs = circ->ys = circ->candidate_counts = NULL;
+	circ->bins = NULL;
+	circ->point_cap = 0;
+	circ->band_votes = NULL;
+	circ->candidates = circ->circles = NULL;
+}
+
+//***************************************************************//
+// Make room for n points, with some slack so a frame a little busier
+// than the last does not reallocate
+//***************************************************************//
+static bool circles_reserve(hough_circles_t *circ, unsigned long n)
+{
+	int *xs, *ys;
+	unsigned char *bins;
+	
+	if(n <= circ->point_cap)
+		return true;
+	n += n / 4;
+	xs = (int *)realloc(circ->xs, sizeof(int) * n);
+	if(xs)
+		circ->xs = xs;
+	ys = (int *)realloc(circ->ys, sizeof(int) * n);
+	if(ys)
+		circ->ys = ys;
+	bins = (unsigned char *)realloc(circ->bins, n);
+	if(bins)
+		circ->bins = bins;
+	if(!xs || !ys || !bins)
+		return false;
+	circ->point_cap = n;
+	return true;
+}
+
+//***************************************************************//
+// Walk the set bits of the mask into raster ordered point lists
+// with the orientation bin of each
+//***************************************************************//
+static unsigned long circles_compact(hough_circles_t *circ, const edge_mask_t *edges, const gradient_t *grad)
+{
+	unsigned long n = 0;
+	
+	for(unsigned int y = 0; y < edges->height; y++)
+	{
+		const uint64_t *row = edge_mask_row(edges, y);
+		for(unsigned int k = 0; k < edges->words_per_row; k++)
+		{
+			uint64_t word = row[k];
+			while(word)
+			{
+				unsigned int x = k*64 + __builtin_ctzll(word);
+				circ->xs[n] = x;
+				circ->ys[n] = y;
+				circ->bins[n] = grad->orient[x + (unsigned long)y * grad->width];
+				n++;
+				word &= word - 1;	// clear lowest set bit
+			}
+		}
+	}
+	return n;
+}
+
+//***************************************************************//
+// First point, in raster order, on row y or below
+//***************************************************************//
+static unsigned long circles_first_row(const hough_circles_t *circ, int y)
+{
+	unsigned long lo = 0, hi = circ->points;
+	
+	while(lo < hi)
+	{
+		unsigned long mid = (lo + hi) / 2;
+		if(circ->ys[mid] < y)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+//***************************************************************//
+// Each worker clears its band of centre rows of the shared
+// accumulator and casts the votes that land in it, both ways along
+// the gradient from rmin to rmax, from the points in reach
+//***************************************************************//
+static void circles_vote_band(void *arg, int index, int count)
+{
+	hough_circles_t *circ = (hough_circles_t *)arg;
+	int w = circ->width, h = circ->height;
+	int y0 = h * index / count, y1 = h * (index+1) / count;
+	unsigned int *acc = circ->acc;
+	unsigned long votes = 0;
+	
+	memset(&acc[(unsigned long)y0 * w], 0, sizeof(unsigned int) * (y1 - y0) * w);
+	
+	// A centre is at most rmax rows (and the walk's half pixel) from its point
+	for(unsigned long i=circles_first_row(circ, y0 - circ->rmax - 1);
+	    i<circ->points && circ->ys[i] <= y1 + circ->rmax; i++)
+	{
+		for(int side=-1; side<=1; side+=2)
+		{
+			int dx = (int)floorf(side * circ->dir_x[circ->bins[i]] * (1 << WALK_SHIFT) + 0.5f);
+			int dy = (int)floorf(side * circ->dir_y[circ->bins[i]] * (1 << WALK_SHIFT) + 0.5f);
+			int fx = (circ->xs[i] << WALK_SHIFT) + (1 << (WALK_SHIFT-1)) + circ->rmin * dx;
+			int fy = (circ->ys[i] << WALK_SHIFT) + (1 << (WALK_SHIFT-1)) + circ->rmin * dy;
+			
+			for(int r=circ->rmin; r<=circ->rmax; r++, fx += dx, fy += dy)
+			{
+				int cx = fx >> WALK_SHIFT, cy = fy >> WALK_SHIFT;
+				
+				// Moving away from the point, once outside it stays outside
+				if(cx < 0 || cy < 0 || cx >= w || cy >= h)
+					break;
+				if(cy < y0 || cy >= y1)
+				{
+					// Past the band the same way, or not there yet
+					if(dy == 0 || (dy > 0) == (cy >= y1))
+						break;
+					continue;
+				}
+				acc[(unsigned long)cy * w + cx]++;
+				votes++;
+			}
+		}
+	}
+	circ->band_votes[index] = votes;
+}
+
+//***************************************************************//
+// More centre votes first, then raster order
+//***************************************************************//
+static inline bool centre_better(const hough_circle_t *a, const hough_circle_t *b)
+{
+	if(a->centre_votes != b->centre_votes)
+		return a->centre_votes > b->centre_votes;
+	if(a->y != b->y)
+		return a->y < b->y;
+	return a->x < b->x;
+}
+
+static int centre_compare(const void *a, const void *b)
+{
+	const hough_circle_t *ca = (const hough_circle_t *)a, *cb = (const hough_circle_t *)b;
+	return centre_better(ca, cb) ? -1 : centre_better(cb, ca) ? 1 : 0;
+}
+
+//***************************************************************//
+// 3x3 local maxima of a band of rows, each worker keeps its best
+// max_circles*HOUGH_CIRCLE_SPREAD in a sorted list
+//***************************************************************//
+static void circles_centres_band(void *arg, int index, int count)
+{
+	hough_circles_t *circ = (hough_circles_t *)arg;
+	int w = circ->width, h = circ->height;
+	int cap = circ->max_circles * HOUGH_CIRCLE_SPREAD;
+	int y0 = 1 + (h-2) * index / count, y1 = 1 + (h-2) * (index+1) / count;
+	hough_circle_t *list = &circ->candidates[cap * index];
+	int n = 0;
+	
+	for(int y=y0; y<y1; y++)
+	{
+		const unsigned int *row = &circ->acc[(unsigned long)y * w];
+		for(int x=1; x<w-1; x++)
+		{
+			unsigned int v = row[x];
+			hough_circle_t c;
+			int k;
+			
+			if(v < circ->min_votes || (n == cap && v <= list[n-1].centre_votes))
+				continue;
+			
+			// Ties go to the first cell in raster order
+			if(row[x-w-1] >= v || row[x-w] >= v || row[x-w+1] >= v || row[x-1] >= v ||
+			   row[x+1] > v || row[x+w-1] > v || row[x+w] > v || row[x+w+1] > v)
+				continue;
+			c.x = x;
+			c.y = y;
+			c.r = 0;
+			c.votes = 0;
+			c.centre_votes = v;
+			
+			// Insert into the sorted list, dropping the weakest when full
+			k = (n < cap) ? n++ : n-1;
+			while(k > 0 && centre_better(&c, &list[k-1]))
+			{
+				list[k] = list[k-1];
+				k--;
+			}
+			list[k] = c;
+		}
+	}
+	circ->candidate_counts[index] = n;
+}
+
+//***************************************************************//
+// Radius histogram of each candidate centre, from the edge pixels
+// around it whose gradient lines up with the way to the centre
+//***************************************************************//
+static void circles_radius_band(void *arg, int index, int count)
+{
+	hough_circles_t *circ = (hough_circles_t *)arg;
+	int c0 = circ->candidate_count * index / count;
+	int c1 = circ->candidate_count * (index+1) / count;
+	int rmin = circ->rmin, rmax = circ->rmax;
+	float inner = (rmin - 0.5f) * (rmin - 0.5f), outer = (rmax + 0.5f) * (rmax + 0.5f);
+	
+	for(int c=c0; c<c1; c++)
+	{
+		hough_circle_t *cand = &circ->candidates[c];
+		unsigned int *hist = &circ->hists[(rmax + 2) * c];
+		float best_score = -1.0f;
+		
+		memset(hist, 0, sizeof(unsigned int) * (rmax + 2));
+		
+		// The points are in raster order, start at the first row in reach
+		for(unsigned long i=circles_first_row(circ, cand->y - rmax); i<circ->points && circ->ys[i] <= cand->y + rmax; i++)
+		{
+			float dx = (float)(circ->xs[i] - cand->x), dy = (float)(circ->ys[i] - cand->y);
+			float d2 = dx*dx + dy*dy, d, align;
+			
+			if(d2 < inner || d2 > outer)
+				continue;
+			d = sqrtf(d2);
+			align = (dx * circ->dir_x[circ->bins[i]] + dy * circ->dir_y[circ->bins[i]]) / d;
+			if(fabsf(align) < ALIGN_MIN)
+				continue;
+			hist[(int)(d + 0.5f)]++;
+		}
+		
+		// The radius with the largest share of its circumference, a bin either
+		// side to absorb rounding
+		cand->r = 0;
+		cand->votes = 0;
+		for(int r=rmin; r<=rmax; r++)
+		{
+			unsigned int support = hist[r-1] + hist[r] + hist[r+1];
+			float score = (float)support / r;
+			if(support >= circ->min_votes && score > best_score)
+			{
+				best_score = score;
+				cand->r = r;
+				cand->votes = support;
+			}
+		}
+	}
+}
+
+void CPU_hough_circles(hough_circles_t *circ, const edge_mask_t *edges, const gradient_t *grad)
+{
+	int cap = circ->max_circles * HOUGH_CIRCLE_SPREAD;
+	int candidates = 0, kept = 0;
+	long min_dist2 = (long)circ->min_dist * circ->min_dist;
+	
+	circ->count = 0;
+	if(workers_count() != circ->workers)
+	{
+		printf("CPU Hough circles were allocated for %d workers but %d are running.\n", circ->workers, workers_count());
+		return;
+	}
+	if(grad == NULL || grad->orient == NULL)
+	{
+		printf("CPU Hough circles need a gradient with orientations.\n");
+		return;
+	}
+	for(int b=0; b<grad->orient_bins; b++)
+	{
+		double angle = b * 180.0 / grad->orient_bins * DEG2RAD;
+		circ->dir_x[b] = (float)cos(angle);
+		circ->dir_y[b] = (float)sin(angle);
+	}
+	
+	// Centre votes
+	if(!circles_reserve(circ, edge_mask_count(edges)))
+	{
+		printf("Could not allocate the Hough circle points.\n");
+		return;
+	}
+	circ->points = circles_compact(circ, edges, grad);
+	workers_run(circles_vote_band, circ);
+	circ->votes = 0;
+	for(int w=0; w<circ->workers; w++)
+		circ->votes += circ->band_votes[w];
+	
+	// Strongest centres at least min_dist apart
+	workers_run(circles_centres_band, circ);
+	for(int w=0; w<circ->workers; w++)
+	{
+		memmove(&circ->candidates[candidates], &circ->candidates[cap * w], sizeof(hough_circle_t) * circ->candidate_counts[w]);
+		candidates += circ->candidate_counts[w];
+	}
+	qsort(circ->candidates, candidates, sizeof(hough_circle_t), centre_compare);
+	candidates = (candidates > cap) ? cap : candidates;	// the same list whatever the thread count
+	for(int c=0; c<candidates && kept<cap; c++)
+	{
+		bool near = false;
+		for(int k=0; k<kept && !near; k++)
+		{
+			long dx = circ->candidates[c].x - circ->candidates[k].x, dy = circ->candidates[c].y - circ->candidates[k].y;
+			near = dx*dx + dy*dy < min_dist2;
+		}
+		if(!near)
+			circ->candidates[kept++] = circ->candidates[c];
+	}
+	circ->candidate_count = kept;
+	
+	// Radii, then keep the supported circles in centre order
+	workers_run(circles_radius_band, circ);
+	for(int c=0; c<kept && circ->count<circ->max_circles; c++)
+	{
+		if(circ->candidates[c].votes)
+			circ->circles[circ->count++] = circ->candidates[c];
+	}
+}
+
+void hough_circles_to_image(const hough_circles_t *circ, unsigned char *img_out)
+{
+	unsigned long cells = (unsigned long)circ->width * circ->height;
+	
+	for(unsigned long c=0; c<cells; c++)
+		img_out[c] = (circ->acc[c] > MAXRGB) ? MAXRGB : circ->acc[c];
+}
+
+void hough_circles_write(const hough_circles_t *circ, FILE *fp, unsigned long frame)
+{
+	for(int i=0; i<circ->count; i++)
+	{
+		const hough_circle_t *c = &circ->circles[i];
+		fprintf(fp, "%lu %d %d %d %u\n", frame, c->x, c->y, c->r, c->votes);
+	}
+}
@@ -0,0 +1,87 @@
+//*****************************************************************************************//
+//  hough_circles.h - Gradient voting CPU Hough circle detector (-circles)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	The centre of a circle lies on the gradient line of every one of its edge pixels,
+//	rmin to rmax pixels away on one side or the other. Instead of a full (x, y, r)
+//	sweep each edge pixel votes the 2*(rmax-rmin+1) centres along that line into a
+//	2D centre accumulator, so the memory is O(width*height) whatever the radius range
+//	or the thread count. The accumulator is shared: each worker owns a band of centre
+//	rows and walks only the points within rmax rows of it (the points are in raster
+//	order, so a binary search finds them), casting just the votes that land in its
+//	band. No two workers write the same cell and there is nothing to reduce.
+//
+//	Centres are the local maxima of at least min_votes votes, strongest first and at
+//	least min_dist pixels apart. The radius of each comes from a histogram of the
+//	distances to the edge pixels around it whose gradient points at it; the radius
+//	with the largest share of its circumference wins, and the circle is kept when
+//	at least min_votes pixels support it.
+//
+//	Circle lists, like the line lists of hough_peaks.h: one "frame x y r votes" line
+//	per circle, centre and radius in pixels, strongest centre first.
+//
+//*****************************************************************************************//
+#ifndef HOUGH_CIRCLES_H
+#define HOUGH_CIRCLES_H
+
+#include <stdio.h>
+
+#include "edgemask.h"
+#include "gradient.h"
+
+#define HOUGH_CIRCLE_SPREAD	4		// centre candidates examined per circle asked for
+
+typedef struct
+{
+	int x;					// centre, pixels
+	int y;
+	int r;					// radius, pixels
+	unsigned int votes;		// edge pixels on the circle
+	unsigned int centre_votes;
+} hough_circle_t;
+
+typedef struct
+{
+	int width;				// image size
+	int height;
+	int rmin;
+	int rmax;
+	int max_circles;
+	unsigned int min_votes;
+	int min_dist;			// between centres
+	int workers;
+	float dir_x[256];		// unit gradient direction of each orientation bin
+	float dir_y[256];
+	unsigned int *acc;		// width*height centre votes
+	int *xs;				// edge points of the current frame, raster order
+	int *ys;
+	unsigned char *bins;	// and their orientation bins
+	unsigned long points;
+	unsigned long point_cap;	// room in xs/ys/bins, grown to the edge count of a frame
+	unsigned long votes;	// centre votes cast in the current frame
+	unsigned long *band_votes;	// cast by each worker
+	hough_circle_t *candidates;	// per worker, then merged
+	int *candidate_counts;
+	int candidate_count;
+	unsigned int *hists;	// rmax+2 radius counts per candidate
+	hough_circle_t *circles;	// the accepted circles, strongest centre first
+	int count;
+} hough_circles_t;
+
+// Allocate for a width x height image and up to max_circles circles of rmin to
+// rmax pixels, found by workers threads
+bool hough_circles_alloc(hough_circles_t *circ, int width, int height, int rmin, int rmax, int max_circles,
+                         unsigned int min_votes, int min_dist, int workers);
+void hough_circles_free(hough_circles_t *circ);
+
+// Find the circles of edges; grad supplies the orientations and needs orient_bins > 0
+void CPU_hough_circles(hough_circles_t *circ, const edge_mask_t *edges, const gradient_t *grad);
+
+// Saturate the centre accumulator to 8 bits, width x height
+void hough_circles_to_image(const hough_circles_t *circ, unsigned char *img_out);
+
+// Append the circles of one frame to an open circle list
+void hough_circles_write(const hough_circles_t *circ, FILE *fp, unsigned long frame);
+
+#endif
@@ -0,0 +1,665 @@
+//*****************************************************************************************//
+//  hough_cpu.cpp - Multithreaded CPU Hough line transform
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "hough_cpu.h"
+#include "workers.h"
+
+#define MAXRGB		255
+#define LINE_CELLS	16			// 32 bit counters per 64 byte cache line
+#define PAGE_CELLS	1024		// and per 4K page
+#define TRANSPOSE_ROWS	64		// rho rows transposed together by the tiled reduction
+
+bool hough_parse_engine(const char *name, hough_engine_t *engine)
+{
+	if(strcmp(name, "blocked") == 0)
+		*engine = HOUGH_ENGINE_BLOCKED;
+	else if(strcmp(name, "prob") == 0)
+		*engine = HOUGH_ENGINE_PROB;
+	else if(strcmp(name, "ppht") == 0)
+		*engine = HOUGH_ENGINE_PPHT;
+	else if(strcmp(name, "pyramid") == 0)
+		*engine = HOUGH_ENGINE_PYRAMID;
+	else if(strcmp(name, "fht") == 0)
+		*engine = HOUGH_ENGINE_FHT;
+	else if(strcmp(name, "auto") == 0)
+		*engine = HOUGH_ENGINE_AUTO;
+	else
+		return false;
+	return true;
+}
+
+bool hough_parse_layout(const char *name, hough_layout_t *layout)
+{
+	if(strcmp(name, "blocked") == 0)
+		*layout = HOUGH_LAYOUT_BLOCKED;
+	else if(strcmp(name, "tiled") == 0)
+		*layout = HOUGH_LAYOUT_TILED;
+	else
+		return false;
+	return true;
+}
+
+void hough_params_default(hough_params_t *params)
+{
+	params->theta_min = 0.0f;
+	params->theta_max = 180.0f;
+	params->theta_step = 1.0f;
+	params->rho_step = 1.0f;
+	params->orient_window = -1;
+	params->layout = HOUGH_LAYOUT_BLOCKED;
+}
+
+bool hough_params_valid(const hough_params_t *params)
+{
+	if(!(params->theta_step > 0.0f) || !(params->rho_step > 0.0f))
+	{
+		printf("Hough theta and rho steps must be positive.\n");
+		return false;
+	}
+	if(!(params->theta_max > params->theta_min) || params->theta_max - params->theta_min > 180.0f)
+	{
+		printf("Hough theta range must be increasing and at most 180 degrees.\n");
+		return false;
+	}
+	if(params->orient_window < -1)
+	{
+		printf("Hough orientation window must be at least 0 bins.\n");
+		return false;
+	}
+	return true;
+}
+
+void hough_geometry(const hough_params_t *params, int width, int height, int *hough_h, int *theta_bins)
+{
+	// Same centre as the kernel, the farthest pixel from it is the (0, 0) corner
+	float cx = (float)(width/2), cy = (float)(height/2);
+	
+	*hough_h = (int)ceilf(sqrtf(cx*cx + cy*cy) / params->rho_step);
+	*theta_bins = (int)ceilf((params->theta_max - params->theta_min) / params->theta_step - 0.001f);
+	if(*theta_bins < 1)
+		*theta_bins = 1;
+}
+
+void hough_tables(const hough_params_t *params, int theta_bins, float *cos_t, float *sin_t)
+{
+	for(int t=0; t<theta_bins; t++)
+	{
+		double theta = (params->theta_min + t * (double)params->theta_step) * DEG2RAD;
+		cos_t[t] = (float)cos(theta);
+		sin_t[t] = (float)sin(theta);
+	}
+}
+
+bool hough_alloc(hough_t *hough, int width, int height, const hough_params_t *params, int workers)
+{
+	unsigned long cells;
+	
+	memset(hough, 0, sizeof(hough_t));
+	hough->width = width;
+	hough->height = height;
+	hough->params = *params;
+	hough_geometry(params, width, height, &hough->hough_h, &hough->theta_bins);
+	hough->rho_bins = 2*hough->hough_h + 1;
+	hough->theta_stride = (hough->theta_bins + HOUGH_THETA_BLOCK-1) / HOUGH_THETA_BLOCK * HOUGH_THETA_BLOCK;
+	hough->workers = (workers < 1) ? 1 : workers;
+	hough->windowed = params->orient_window >= 0 && 2*params->orient_window + 1 < hough->theta_bins;
+	hough->wraps = fabsf(hough->theta_bins * params->theta_step - 180.0f) < 0.001f;
+	hough->tiled = params->layout == HOUGH_LAYOUT_TILED && !hough->windowed;
+	cells = (unsigned long)hough->rho_bins * hough->theta_stride;
+	
+	// Tiled rows start on a cache line, and a whole number of pages apart would
+	// put the same rho of every angle of a tile in one cache set
+	hough->rho_stride = (hough->rho_bins + LINE_CELLS-1) / LINE_CELLS * LINE_CELLS;
+	if(hough->rho_stride % PAGE_CELLS == 0)
+		hough->rho_stride += LINE_CELLS;
+	hough->partial_cells = hough->tiled ? (unsigned long)hough->theta_stride * hough->rho_stride : cells;
+	
+	hough->cos_t = (float *)calloc(hough->theta_stride, sizeof(float));
+	hough->sin_t = (float *)calloc(hough->theta_stride, sizeof(float));
+	hough->acc = (unsigned int *)malloc(sizeof(unsigned int) * cells);
+	hough->partial = (unsigned int *)malloc(sizeof(unsigned int) * hough->partial_cells * hough->workers);
+	hough->xs = (float *)malloc(sizeof(float) * width * height);
+	hough->ys = (float *)malloc(sizeof(float) * width * height);
+	hough->ts = hough->windowed ? (short *)malloc(sizeof(short) * width * height) : NULL;
+	hough->band_votes = (unsigned long *)calloc(hough->workers, sizeof(unsigned long));
+	if(!hough->cos_t || !hough->sin_t || !hough->acc || !hough->partial || !hough->xs || !hough->ys ||
+	   (hough->windowed && !hough->ts) || !hough->band_votes)
+	{
+		hough_free(hough);
+		return false;
+	}
+	
+	// Tables are built once, the kernel calls cos() and sin() per vote. Folding
+	// 1/rho_step in saves a multiply per vote. The padding angles stay zero and
+	// vote every point into rho = hough_h, past the end of the exported row.
+	hough_tables(params, hough->theta_bins, hough->cos_t, hough->sin_t);
+	for(int t=0; t<hough->theta_bins; t++)
+	{
+		hough->cos_t[t] /= params->rho_step;
+		hough->sin_t[t] /= params->rho_step;
+	}
+	return true;
+}
+
+void hough_free(hough_t *hough)
+{
+	free(hough->cos_t);
+	free(hough->sin_t);
+	free(hough->acc);
+	free(hough->partial);
+	free(hough->xs);
+	free(hough->ys);
+	free(hough->ts);
+	free(hough->band_votes);
+	hough->cos_t = hough->sin_t = NULL;
+	hough->acc = hough->partial = NULL;
+	hough->xs = hough->ys = NULL;
+	hough->ts = NULL;
+	hough->band_votes = NULL;
+}
+
+//***************************************************************//
+// Theta bin of each gradient orientation bin. The orientation is
+// folded into the 180 degrees centred on the theta range, so bins
+// just outside a partial range still reach it through the window.
+//***************************************************************//
+static void hough_orient_lut(hough_t *hough, int orient_bins)
+{
+	const hough_params_t *params = &hough->params;
+	float mid = 0.5f * (params->theta_min + params->theta_max);
+	
+	for(int b=0; b<orient_bins; b++)
+	{
+		float theta = b * 180.0f / orient_bins;
+		int t;
+		
+		while(theta < mid - 90.0f)
+			theta += 180.0f;
+		while(theta >= mid + 90.0f)
+			theta -= 180.0f;
+		t = (int)floorf((theta - params->theta_min) / params->theta_step + 0.5f);
+		if(hough->wraps)
+			t = (t + hough->theta_bins) % hough->theta_bins;
+		hough->orient_lut[b] = (short)t;
+	}
+}
+
+//***************************************************************//
+// Phase one: walk the set bits of the mask and store the points
+// from index n on, relative to the centre used by the kernel, with
+// the theta bin of their gradient when voting in a window (grad is
+// NULL for callers that vote every angle)
+//***************************************************************//
+static unsigned long hough_compact(hough_t *hough, const edge_mask_t *edges, const gradient_t *grad, unsigned long n)
+{
+	float cx = (float)(hough->width/2), cy = (float)(hough->height/2);
+	bool orient = hough->windowed && grad != NULL;
+	
+	if(orient)
+		hough_orient_lut(hough, grad->orient_bins);
+	
+	for(unsigned int y = 0; y < edges->height; y++)
+	{
+		const uint64_t *row = edge_mask_row(edges, y);
+		for(unsigned int k = 0; k < edges->words_per_row; k++)
+		{
+			uint64_t word = row[k];
+			while(word)
+			{
+				unsigned int x = k*64 + __builtin_ctzll(word);
+				hough->xs[n] = (float)x - cx;
+				hough->ys[n] = (float)y - cy;
+				if(orient)
+					hough->ts[n] = hough->orient_lut[grad->orient[x + (unsigned long)y * grad->width]];
+				n++;
+				word &= word - 1;	// clear lowest set bit
+			}
+		}
+	}
+	return n;
+}
+
+//***************************************************************//
+// Truncated x*cos + y*sin + offset for one block of angles
+//***************************************************************//
+static inline void hough_block_rhos(int *rho, const float *cos_t, const float *sin_t, float x, float y, float offset)
+{
+#if defined(__AVX2__)
+	__m256 vx = _mm256_set1_ps(x), vy = _mm256_set1_ps(y), voff = _mm256_set1_ps(offset);
+	for(int k=0; k<HOUGH_THETA_BLOCK; k+=8)
+	{
+		__m256 c = _mm256_loadu_ps(&cos_t[k]), s = _mm256_loadu_ps(&sin_t[k]);
+#if defined(__FMA__)
+		__m256 r = _mm256_fmadd_ps(vx, c, _mm256_fmadd_ps(vy, s, voff));
+#else
+		__m256 r = _mm256_add_ps(_mm256_mul_ps(vx, c), _mm256_add_ps(_mm256_mul_ps(vy, s), voff));
+#endif
+		_mm256_storeu_si256((__m256i *)&rho[k], _mm256_cvttps_epi32(r));
+	}
+#elif defined(__SSE2__)
+	__m128 vx = _mm_set1_ps(x), vy = _mm_set1_ps(y), voff = _mm_set1_ps(offset);
+	for(int k=0; k<HOUGH_THETA_BLOCK; k+=4)
+	{
+		__m128 c = _mm_loadu_ps(&cos_t[k]), s = _mm_loadu_ps(&sin_t[k]);
+		__m128 r = _mm_add_ps(_mm_mul_ps(vx, c), _mm_add_ps(_mm_mul_ps(vy, s), voff));
+		_mm_storeu_si128((__m128i *)&rho[k], _mm_cvttps_epi32(r));
+	}
+#else
+	for(int k=0; k<HOUGH_THETA_BLOCK; k++)
+		rho[k] = (int)(x*cos_t[k] + (y*sin_t[k] + offset));
+#endif
+}
+
+//***************************************************************//
+// Phase two: each worker votes its slice of the points, one block
+// of angles at a time, into its own accumulator
+//***************************************************************//
+static void hough_vote_band(void *arg, int index, int count)
+{
+	hough_t *hough = (hough_t *)arg;
+	int stride = hough->theta_stride;
+	unsigned long cells = (unsigned long)hough->rho_bins * stride;
+	unsigned int *acc = &hough->partial[cells * index];
+	unsigned long span = hough->vote_end - hough->vote_begin;
+	unsigned long p0 = hough->vote_begin + span * index / count;
+	unsigned long p1 = hough->vote_begin + span * (index+1) / count;
+	float offset = (float)hough->hough_h + 0.5f;	// round(r + hough_h)
+	int rho[HOUGH_THETA_BLOCK];
+	
+	if(hough->vote_clear)
+		memset(acc, 0, sizeof(unsigned int) * cells);
+	for(int t0=0; t0<stride; t0+=HOUGH_THETA_BLOCK)
+	{
+		const float *cos_t = &hough->cos_t[t0], *sin_t = &hough->sin_t[t0];
+		unsigned int *block = &acc[t0];
+		
+		for(unsigned long i=p0; i<p1; i++)
+		{
+			hough_block_rhos(rho, cos_t, sin_t, hough->xs[i], hough->ys[i], offset);
+			
+			// Unrolled so the rhos are read straight out of the vector store
+			for(int k=0; k<HOUGH_THETA_BLOCK; k+=4)
+			{
+				block[rho[k] * stride + k]++;
+				block[rho[k+1] * stride + k+1]++;
+				block[rho[k+2] * stride + k+2]++;
+				block[rho[k+3] * stride + k+3]++;
+			}
+		}
+	}
+}
+
+//***************************************************************//
+// Phase two with theta-major accumulators: the same blocks of
+// angles, each angle voting into its own rho row of the tile
+//***************************************************************//
+static void hough_vote_tiled_band(void *arg, int index, int count)
+{
+	hough_t *hough = (hough_t *)arg;
+	int stride = hough->theta_stride, rows = hough->rho_stride;
+	unsigned int *acc = &hough->partial[hough->partial_cells * index];
+	unsigned long span = hough->vote_end - hough->vote_begin;
+	unsigned long p0 = hough->vote_begin + span * index / count;
+	unsigned long p1 = hough->vote_begin + span * (index+1) / count;
+	float offset = (float)hough->hough_h + 0.5f;	// round(r + hough_h)
+	int rho[HOUGH_THETA_BLOCK];
+	
+	if(hough->vote_clear)
+		memset(acc, 0, sizeof(unsigned int) * hough->partial_cells);
+	for(int t0=0; t0<stride; t0+=HOUGH_THETA_BLOCK)
+	{
+		const float *cos_t = &hough->cos_t[t0], *sin_t = &hough->sin_t[t0];
+		unsigned int *tile = &acc[(unsigned long)t0 * rows];
+		
+		for(unsigned long i=p0; i<p1; i++)
+		{
+			hough_block_rhos(rho, cos_t, sin_t, hough->xs[i], hough->ys[i], offset);
+			for(int k=0; k<HOUGH_THETA_BLOCK; k+=4)
+			{
+				tile[k * rows + rho[k]]++;
+				tile[(k+1) * rows + rho[k+1]]++;
+				tile[(k+2) * rows + rho[k+2]]++;
+				tile[(k+3) * rows + rho[k+3]]++;
+			}
+		}
+	}
+}
+
+//***************************************************************//
+// Phase two with an orientation window: each point only votes the
+// theta bins within orient_window of its gradient, wrapping round a
+// full 180 degree range and clipped to a partial one
+//***************************************************************//
+static void hough_vote_window_band(void *arg, int index, int count)
+{
+	hough_t *hough = (hough_t *)arg;
+	int stride = hough->theta_stride;
+	int thetas = hough->theta_bins;
+	int window = hough->params.orient_window;
+	unsigned long cells = (unsigned long)hough->rho_bins * stride;
+	unsigned int *acc = &hough->partial[cells * index];
+	unsigned long span = hough->vote_end - hough->vote_begin;
+	unsigned long p0 = hough->vote_begin + span * index / count;
+	unsigned long p1 = hough->vote_begin + span * (index+1) / count;
+	float offset = (float)hough->hough_h + 0.5f;	// round(r + hough_h)
+	unsigned long votes = 0;
+	
+	if(hough->vote_clear)
+		memset(acc, 0, sizeof(unsigned int) * cells);
+	for(unsigned long i=p0; i<p1; i++)
+	{
+		float x = hough->xs[i], y = hough->ys[i];
+		int t0 = hough->ts[i] - window, t1 = hough->ts[i] + window;
+		
+		if(!hough->wraps)
+		{
+			t0 = (t0 < 0) ? 0 : t0;
+			t1 = (t1 >= thetas) ? thetas-1 : t1;
+		}
+		for(int t=t0; t<=t1; t++)
+		{
+			int tt = (t < 0) ? t + thetas : (t >= thetas) ? t - thetas : t;
+			int rho = (int)(x * hough->cos_t[tt] + (y * hough->sin_t[tt] + offset));
+			acc[rho * stride + tt]++;
+		}
+		votes += (t1 >= t0) ? t1 - t0 + 1 : 0;
+	}
+	hough->band_votes[index] = votes;
+}
+
+//***************************************************************//
+// Update the merged accumulator in place: points before vote_begin
+// add their votes and the rest take theirs back. Each worker owns
+// a slice of the theta blocks, so no two write the same cell.
+//***************************************************************//
+static void hough_update_band(void *arg, int index, int count)
+{
+	hough_t *hough = (hough_t *)arg;
+	int stride = hough->theta_stride;
+	int blocks = stride / HOUGH_THETA_BLOCK;
+	int b0 = blocks * index / count, b1 = blocks * (index+1) / count;
+	float offset = (float)hough->hough_h + 0.5f;	// round(r + hough_h)
+	int rho[HOUGH_THETA_BLOCK];
+	
+	for(int b=b0; b<b1; b++)
+	{
+		int t0 = b * HOUGH_THETA_BLOCK;
+		const float *cos_t = &hough->cos_t[t0], *sin_t = &hough->sin_t[t0];
+		unsigned int *block = &hough->acc[t0];
+		
+		for(unsigned long i=0; i<hough->vote_begin; i++)
+		{
+			hough_block_rhos(rho, cos_t, sin_t, hough->xs[i], hough->ys[i], offset);
+			for(int k=0; k<HOUGH_THETA_BLOCK; k+=4)
+			{
+				block[rho[k] * stride + k]++;
+				block[rho[k+1] * stride + k+1]++;
+				block[rho[k+2] * stride + k+2]++;
+				block[rho[k+3] * stride + k+3]++;
+			}
+		}
+		for(unsigned long i=hough->vote_begin; i<hough->points; i++)
+		{
+			hough_block_rhos(rho, cos_t, sin_t, hough->xs[i], hough->ys[i], offset);
+			for(int k=0; k<HOUGH_THETA_BLOCK; k+=4)
+			{
+				block[rho[k] * stride + k]--;
+				block[rho[k+1] * stride + k+1]--;
+				block[rho[k+2] * stride + k+2]--;
+				block[rho[k+3] * stride + k+3]--;
+			}
+		}
+	}
+}
+
+//***************************************************************//
+// Add points [vote_begin, vote_end) straight into the merged
+// accumulator, each worker owning a slice of the theta blocks. A
+// windowed point only votes the bins of its window in the slice.
+//***************************************************************//
+static void hough_add_band(void *arg, int index, int count)
+{
+	hough_t *hough = (hough_t *)arg;
+	int stride = hough->theta_stride;
+	int thetas = hough->theta_bins;
+	int blocks = stride / HOUGH_THETA_BLOCK;
+	int b0 = blocks * index / count, b1 = blocks * (index+1) / count;
+	float offset = (float)hough->hough_h + 0.5f;	// round(r + hough_h)
+	int rho[HOUGH_THETA_BLOCK];
+	
+	if(hough->windowed)
+	{
+		int window = hough->params.orient_window;
+		int first = b0 * HOUGH_THETA_BLOCK, last = b1 * HOUGH_THETA_BLOCK;
+		unsigned long votes = 0;
+		
+		for(unsigned long i=hough->vote_begin; i<hough->vote_end; i++)
+		{
+			float x = hough->xs[i], y = hough->ys[i];
+			int t0 = hough->ts[i] - window, t1 = hough->ts[i] + window;
+			
+			if(!hough->wraps)
+			{
+				t0 = (t0 < 0) ? 0 : t0;
+				t1 = (t1 >= thetas) ? thetas-1 : t1;
+			}
+			for(int t=t0; t<=t1; t++)
+			{
+				int tt = (t < 0) ? t + thetas : (t >= thetas) ? t - thetas : t;
+				if(tt < first || tt >= last)
+					continue;
+				int r = (int)(x * hough->cos_t[tt] + (y * hough->sin_t[tt] + offset));
+				hough->acc[r * stride + tt]++;
+				votes++;
+			}
+		}
+		hough->band_votes[index] = votes;
+		return;
+	}
+	
+	for(int b=b0; b<b1; b++)
+	{
+		int t0 = b * HOUGH_THETA_BLOCK;
+		const float *cos_t = &hough->cos_t[t0], *sin_t = &hough->sin_t[t0];
+		unsigned int *block = &hough->acc[t0];
+		
+		for(unsigned long i=hough->vote_begin; i<hough->vote_end; i++)
+		{
+			hough_block_rhos(rho, cos_t, sin_t, hough->xs[i], hough->ys[i], offset);
+			for(int k=0; k<HOUGH_THETA_BLOCK; k+=4)
+			{
+				block[rho[k] * stride + k]++;
+				block[rho[k+1] * stride + k+1]++;
+				block[rho[k+2] * stride + k+2]++;
+				block[rho[k+3] * stride + k+3]++;
+			}
+		}
+	}
+}
+
+//***************************************************************//
+// Sum the per worker accumulators, each worker takes a slice of
+// the cells
+//***************************************************************//
+static void hough_reduce_band(void *arg, int index, int count)
+{
+	hough_t *hough = (hough_t *)arg;
+	unsigned long cells = (unsigned long)hough->rho_bins * hough->theta_stride;
+	unsigned long c0 = cells * index / count;
+	unsigned long c1 = cells * (index+1) / count;
+	
+	memcpy(&hough->acc[c0], &hough->partial[c0], sizeof(unsigned int) * (c1 - c0));
+	for(int w=1; w<hough->workers; w++)
+	{
+		const unsigned int *partial = &hough->partial[cells * w];
+		for(unsigned long c=c0; c<c1; c++)
+			hough->acc[c] += partial[c];
+	}
+}
+
+//***************************************************************//
+// Sum and transpose the theta-major accumulators into acc, each
+// worker takes a slice of the rhos, TRANSPOSE_ROWS of them at a time
+// so the acc lines being filled stay in L1 across the angles
+//***************************************************************//
+static void hough_reduce_tiled_band(void *arg, int index, int count)
+{
+	hough_t *hough = (hough_t *)arg;
+	int stride = hough->theta_stride, rows = hough->rho_stride;
+	int r0 = hough->rho_bins * index / count;
+	int r1 = hough->rho_bins * (index+1) / count;
+	
+	for(int rb=r0; rb<r1; rb+=TRANSPOSE_ROWS)
+	{
+		int re = (rb + TRANSPOSE_ROWS < r1) ? rb + TRANSPOSE_ROWS : r1;
+		for(int t=0; t<stride; t++)
+		{
+			const unsigned int *row = &hough->partial[(unsigned long)t * rows];
+			for(int rho=rb; rho<re; rho++)
+			{
+				unsigned int sum = row[rho];
+				for(int w=1; w<hough->workers; w++)
+					sum += row[hough->partial_cells * w + rho];
+				hough->acc[(unsigned long)rho * stride + t] = sum;
+			}
+		}
+	}
+}
+
+bool CPU_hough_points(hough_t *hough, const edge_mask_t *edges, const gradient_t *grad)
+{
+	if(workers_count() != hough->workers)
+	{
+		printf("CPU Hough was allocated for %d workers but %d are running.\n", hough->workers, workers_count());
+		return false;
+	}
+	if(hough->windowed && (grad == NULL || grad->orient == NULL))
+	{
+		printf("CPU Hough orientation window needs a gradient with orientations.\n");
+		return false;
+	}
+	
+	hough->points = hough_compact(hough, edges, grad, 0);
+	hough->votes = 0;
+	return true;
+}
+
+unsigned long hough_compact_points(hough_t *hough, const edge_mask_t *edges)
+{
+	hough->points = hough_compact(hough, edges, NULL, 0);
+	return hough->points;
+}
+
+void CPU_hough_vote(hough_t *hough, unsigned long begin, unsigned long end, bool clear)
+{
+	hough->vote_begin = begin;
+	hough->vote_end = (end > hough->points) ? hough->points : end;
+	hough->vote_clear = clear;
+	if(clear)
+		hough->votes = 0;
+	
+	if(hough->windowed)
+	{
+		workers_run(hough_vote_window_band, hough);
+		for(int w=0; w<hough->workers; w++)
+			hough->votes += hough->band_votes[w];
+	}
+	else
+	{
+		workers_run(hough->tiled ? hough_vote_tiled_band : hough_vote_band, hough);
+		hough->votes += (hough->vote_end - hough->vote_begin) * hough->theta_bins;
+	}
+	workers_run(hough->tiled ? hough_reduce_tiled_band : hough_reduce_band, hough);
+}
+
+void CPU_hough_add(hough_t *hough, unsigned long begin, unsigned long end, bool clear)
+{
+	hough->vote_begin = begin;
+	hough->vote_end = (end > hough->points) ? hough->points : end;
+	if(clear)
+	{
+		hough->votes = 0;
+		memset(hough->acc, 0, sizeof(unsigned int) * hough->rho_bins * hough->theta_stride);
+	}
+	
+	workers_run(hough_add_band, hough);
+	if(hough->windowed)
+	{
+		for(int w=0; w<hough->workers; w++)
+			hough->votes += hough->band_votes[w];
+	}
+	else
+		hough->votes += (hough->vote_end - hough->vote_begin) * hough->theta_bins;
+}
+
+bool CPU_hough_update(hough_t *hough, const edge_mask_t *added, const edge_mask_t *removed)
+{
+	if(workers_count() != hough->workers)
+	{
+		printf("CPU Hough was allocated for %d workers but %d are running.\n", hough->workers, workers_count());
+		return false;
+	}
+	if(hough->windowed)
+	{
+		printf("CPU Hough updates need every angle voted, not an orientation window.\n");
+		return false;
+	}
+	
+	// Appearing points first, then the vanished ones
+	hough->vote_begin = hough_compact(hough, added, NULL, 0);
+	hough->points = hough_compact(hough, removed, NULL, hough->vote_begin);
+	hough->votes = hough->points * hough->theta_bins;
+	workers_run(hough_update_band, hough);
+	return true;
+}
+
+bool CPU_hough_direct(hough_t *hough, const edge_mask_t *edges)
+{
+	if(workers_count() != hough->workers)
+	{
+		printf("CPU Hough was allocated for %d workers but %d are running.\n", hough->workers, workers_count());
+		return false;
+	}
+	if(hough->windowed)
+	{
+		printf("CPU Hough direct voting needs every angle voted, not an orientation window.\n");
+		return false;
+	}
+	
+	// The update with every point added and none removed, on a cleared accumulator
+	hough->points = hough->vote_begin = hough_compact(hough, edges, NULL, 0);
+	hough->votes = hough->points * hough->theta_bins;
+	memset(hough->acc, 0, sizeof(unsigned int) * hough->rho_bins * hough->theta_stride);
+	workers_run(hough_update_band, hough);
+	return true;
+}
+
+void CPU_hough(hough_t *hough, const edge_mask_t *edges, const gradient_t *grad)
+{
+	if(CPU_hough_points(hough, edges, grad))
+		CPU_hough_vote(hough, 0, hough->points, true);
+}
+
+void hough_to_image(const hough_t *hough, unsigned char *img_out)
+{
+	for(int rho=0; rho<hough->rho_bins; rho++)
+	{
+		const unsigned int *row = &hough->acc[(unsigned long)rho * hough->theta_stride];
+		unsigned char *out = &img_out[(unsigned long)rho * hough->theta_bins];
+		for(int t=0; t<hough->theta_bins; t++)
+			out[t] = (row[t] > MAXRGB) ? MAXRGB : row[t];
+	}
+}
@@ -0,0 +1,168 @@
+//*****************************************************************************************//
+//  hough_cpu.h - Multithreaded CPU Hough line transform
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	Same parameter space as houghTransform in hough_kernel.cu: theta_bins angles of
+//	theta_step degrees from theta_min, rho = (x - cx)*cos(theta) + (y - cy)*sin(theta)
+//	in units of rho_step, rounded and offset by hough_h, stored rho-major with theta
+//	fastest. The defaults (0..180 in 1 degree steps, 1 pixel rho) are the kernel's
+//	original space. hough_h covers the true image diagonal, so every vote lands in
+//	the accumulator whatever the aspect ratio. Unlike the kernel, every worker votes
+//	into its own 32 bit accumulator (no races, no wrap at 255), and the accumulators
+//	are summed by a parallel reduction. hough_to_image() saturates the result to 8
+//	bits so hough.pgm stays comparable with the CUDA output.
+//
+//	Voting is two phase. The edge pixels are first compacted into SoA arrays of
+//	centred x and y, so the cost of the vote depends on the edge count and not on
+//	the image area. The points are then voted one block of HOUGH_THETA_BLOCK angles
+//	at a time: the rhos of a point for the whole block come out of one or two SIMD
+//	multiply-adds, and because a row of the accumulator is padded to theta_stride
+//	(a multiple of the block) the block's votes at any rho land in one 64 byte
+//	cache line. A block touches rho_bins lines, which stay in L2 while every point
+//	is voted into it. Voting time is proportional to the number of blocks, i.e. to
+//	the theta range over theta_step.
+//
+//	Past about 2K the rho_bins lines of a block outgrow L2 and nearly every vote
+//	misses. With -layout=tiled the per worker accumulators are stored theta-major
+//	instead, one rho row per angle padded to rho_stride, and voted one theta tile of
+//	HOUGH_THETA_BLOCK rows at a time. Neighbouring edge points have nearly the same
+//	rho at every angle, so a tile only keeps a few lines per row busy whatever the
+//	image size. The reduction transposes the tiles back into the rho-major acc, so
+//	everything reading acc is unchanged.
+//
+//	With an orientation window (-orient-window=k) a point only votes within k theta
+//	bins either side of its gradient orientation, the normal of the line it lies on,
+//	which cuts the votes by about theta_bins/(2k+1). The orientation is folded into
+//	the 180 degrees centred on the theta range; when the range is the full 180 degrees
+//	the window wraps round, and the bins past the end vote with rho negated simply by
+//	using their own sin/cos.
+//
+//*****************************************************************************************//
+#ifndef HOUGH_CPU_H
+#define HOUGH_CPU_H
+
+#include "edgemask.h"
+#include "gradient.h"
+
+#define DEG2RAD				0.0174533	// same constant as the original houghTransform
+#define HOUGH_THETA_BLOCK	16		// angles voted together, 16 counters = one cache line
+#define HOUGH_ORIENT_BINS	256		// gradient orientation bins for the orientation window
+
+// Voting engines selectable at run time (-engine=)
+typedef enum
+{
+	HOUGH_ENGINE_BLOCKED,	// every point, SIMD angle blocks (or its orientation window)
+	HOUGH_ENGINE_PROB,		// a random sample of the points with early termination, see hough_prob.h
+	HOUGH_ENGINE_PPHT,		// line segments, points consumed as lines are found, see hough_segments.h
+	HOUGH_ENGINE_PYRAMID,	// candidates on a pyrdown image refined at full size, see hough_pyramid.h
+	HOUGH_ENGINE_FHT,		// every dyadic line summed whatever the edge count, see hough_fht.h
+	HOUGH_ENGINE_AUTO		// direct, blocked or prob by edge density each frame, see hough_auto.h
+} hough_engine_t;
+
+// Parse "blocked", "prob", "ppht", "pyramid", "fht" or "auto", returns false for anything else
+bool hough_parse_engine(const char *name, hough_engine_t *engine);
+
+// Layout of the per worker accumulators (-layout=); acc is always rho-major
+typedef enum
+{
+	HOUGH_LAYOUT_BLOCKED,	// rho-major, a row is theta_stride angles
+	HOUGH_LAYOUT_TILED		// theta-major, a row is rho_stride rhos, transposed by the reduction
+} hough_layout_t;
+
+// Parse "blocked" or "tiled", returns false for anything else
+bool hough_parse_layout(const char *name, hough_layout_t *layout);
+
+typedef struct
+{
+	float theta_min;		// degrees, first bin
+	float theta_max;		// degrees, bins stop short of it
+	float theta_step;		// degrees per bin
+	float rho_step;			// pixels per bin
+	int orient_window;		// vote within this many theta bins of the gradient, -1 for all
+	hough_layout_t layout;	// of the per worker accumulators, blocked with a window
+} hough_params_t;
+
+// 0..180 degrees in 1 degree bins, 1 pixel rho bins, every angle voted, blocked layout
+void hough_params_default(hough_params_t *params);
+
+// Check the parameters, prints what is wrong and returns false if they are unusable
+bool hough_params_valid(const hough_params_t *params);
+
+// Accumulator size for a width x height image: theta_bins angles and
+// 2*hough_h + 1 rho bins centred on rho = 0
+void hough_geometry(const hough_params_t *params, int width, int height, int *hough_h, int *theta_bins);
+
+// cos and sin of each of the theta_bins angles
+void hough_tables(const hough_params_t *params, int theta_bins, float *cos_t, float *sin_t);
+
+typedef struct
+{
+	int width;				// image size
+	int height;
+	hough_params_t params;
+	int hough_h;			// rho offset, rho bin = round(r/rho_step) + hough_h
+	int rho_bins;			// 2*hough_h + 1
+	int theta_bins;
+	int theta_stride;		// theta_bins rounded up to whole blocks, row pitch of acc
+	int rho_stride;			// rho_bins rounded up to cache lines, row pitch of a tiled partial
+	bool windowed;			// the orientation window is narrower than the theta range
+	bool tiled;				// theta-major partials, never with the window
+	bool wraps;				// the theta range is the full 180 degrees
+	float *cos_t;			// theta_stride entries, zero past theta_bins,
+	float *sin_t;			// pre-scaled by 1/rho_step
+	unsigned int *acc;		// rho_bins*theta_stride merged votes
+	unsigned int *partial;	// one accumulator per worker, partial_cells each
+	unsigned long partial_cells;
+	int workers;
+	float *xs;				// edge points of the current frame, relative to the centre
+	float *ys;
+	short *ts;				// theta bin of each point's gradient (windowed only)
+	short orient_lut[256];	// gradient orientation bin -> theta bin
+	unsigned long *band_votes;	// votes cast by each worker
+	unsigned long points;
+	unsigned long votes;	// votes cast in the current frame
+	unsigned long vote_begin;	// points of the current CPU_hough_vote/add() call,
+	unsigned long vote_end;		// or the first removed point of CPU_hough_update()
+	bool vote_clear;
+} hough_t;
+
+// Allocate tables and accumulators for a width x height image voted on by
+// workers threads
+bool hough_alloc(hough_t *hough, int width, int height, const hough_params_t *params, int workers);
+void hough_free(hough_t *hough);
+
+// Vote every set pixel of edges into hough->acc on the worker threads. grad
+// supplies the orientations for the window and may be NULL without one.
+void CPU_hough(hough_t *hough, const edge_mask_t *edges, const gradient_t *grad);
+
+// The two phases of CPU_hough() for callers that vote a subset of the points:
+// compact the edges into hough->xs/ys (false on a setup error), then vote points
+// [begin, end) on top of the previous votes, or over a cleared accumulator.
+// hough->acc holds the merged votes after every call.
+bool CPU_hough_points(hough_t *hough, const edge_mask_t *edges, const gradient_t *grad);
+void CPU_hough_vote(hough_t *hough, unsigned long begin, unsigned long end, bool clear);
+
+// CPU_hough_vote() without the per worker accumulators: points [begin, end) are
+// added straight into hough->acc, each worker owning a slice of the theta blocks,
+// so a small batch does not pay for summing every worker's whole accumulator.
+void CPU_hough_add(hough_t *hough, unsigned long begin, unsigned long end, bool clear);
+
+// Compact the edges into hough->xs/ys without gradient theta bins, for engines
+// that vote every angle whatever the window. Returns the number of points.
+unsigned long hough_compact_points(hough_t *hough, const edge_mask_t *edges);
+
+// Update hough->acc in place for a change in the edges: add the votes of the
+// set pixels of added and take back those of removed, which must all have voted.
+// Not with an orientation window. Returns false on a setup error.
+bool CPU_hough_update(hough_t *hough, const edge_mask_t *added, const edge_mask_t *removed);
+
+// Vote every set pixel of edges straight into hough->acc, each worker owning a
+// slice of the theta blocks: no per worker accumulators to clear and sum, which
+// is most of the frame when there are few edges. Not with an orientation window.
+bool CPU_hough_direct(hough_t *hough, const edge_mask_t *edges);
+
+// Saturate the accumulator to 8 bits, theta_bins wide and rho_bins high
+void hough_to_image(const hough_t *hough, unsigned char *img_out);
+
+#endif
@@ -0,0 +1,311 @@
+//*****************************************************************************************//
+//  hough_fht.cpp - Dyadic Fast Hough Transform (-engine=fht)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "hough_fht.h"
+#include "workers.h"
+
+bool hough_fht_alloc(hough_fht_t *fht, int width, int height, int rho_bins, int workers)
+{
+	unsigned long cells = 0;
+	
+	memset(fht, 0, sizeof(hough_fht_t));
+	fht->width = width;
+	fht->height = height;
+	fht->rho_bins = rho_bins;
+	workers = (workers < 1) ? 1 : workers;
+	for(int q=0; q<HOUGH_FHT_QUADRANTS; q++)
+	{
+		// The first two quadrants run down the image, the others across it
+		int across = (q < 2) ? width : height, along = (q < 2) ? height : width;
+		
+		fht->levels[q] = 0;
+		while((1 << fht->levels[q]) < along)
+			fht->levels[q]++;
+		fht->rows[q] = 1 << fht->levels[q];
+		fht->cols[q] = fht->rows[q] + across;
+		if((unsigned long)fht->rows[q] * fht->cols[q] > cells)
+			cells = (unsigned long)fht->rows[q] * fht->cols[q];
+	}
+	fht->buf[0] = (uint16_t *)malloc(sizeof(uint16_t) * cells);
+	fht->buf[1] = (uint16_t *)malloc(sizeof(uint16_t) * cells);
+	fht->columns = (uint16_t *)malloc(sizeof(uint16_t) * rho_bins * workers);
+	if(!fht->buf[0] || !fht->buf[1] || !fht->columns)
+	{
+		hough_fht_free(fht);
+		return false;
+	}
+	return true;
+}
+
+void hough_fht_free(hough_fht_t *fht)
+{
+	free(fht->buf[0]);
+	free(fht->buf[1]);
+	free(fht->columns);
+	fht->buf[0] = fht->buf[1] = fht->columns = NULL;
+}
+
+//***************************************************************//
+// Clear the quadrant's rows, each worker takes a slice
+//***************************************************************//
+static void fht_clear_band(void *arg, int index, int count)
+{
+	hough_fht_t *fht = (hough_fht_t *)arg;
+	int q = fht->quadrant, rows = fht->rows[q], cols = fht->cols[q];
+	int r0 = rows * index / count, r1 = rows * (index+1) / count;
+	
+	memset(&fht->buf[0][(unsigned long)r0 * cols], 0, sizeof(uint16_t) * (r1 - r0) * cols);
+}
+
+//***************************************************************//
+// Set the edge pixels of a slice of the mask rows, mirrored and
+// transposed into the quadrant's orientation, rows columns in
+//***************************************************************//
+static void fht_load_band(void *arg, int index, int count)
+{
+	hough_fht_t *fht = (hough_fht_t *)arg;
+	const edge_mask_t *edges = fht->edges;
+	int q = fht->quadrant, rows = fht->rows[q];
+	unsigned long cols = fht->cols[q];
+	uint16_t *buf = fht->buf[0];
+	unsigned int y0 = edges->height * index / count, y1 = edges->height * (index+1) / count;
+	
+	for(unsigned int y=y0; y<y1; y++)
+	{
+		const uint64_t *row = edge_mask_row(edges, y);
+		for(unsigned int k=0; k<edges->words_per_row; k++)
+		{
+			uint64_t word = row[k];
+			while(word)
+			{
+				unsigned int x = k*64 + __builtin_ctzll(word);
+				switch(q)
+				{
+				case 0:  buf[y * cols + rows + x] = 1; break;
+				case 1:  buf[y * cols + rows + (fht->width - 1 - x)] = 1; break;
+				case 2:  buf[x * cols + rows + y] = 1; break;
+				default: buf[x * cols + rows + (fht->height - 1 - y)] = 1; break;
+				}
+				word &= word - 1;	// clear lowest set bit
+			}
+		}
+	}
+}
+
+//***************************************************************//
+// out = a + b, n counts
+//***************************************************************//
+static inline void fht_add_row(uint16_t *out, const uint16_t *a, const uint16_t *b, int n)
+{
+	int x = 0;
+	
+#if defined(__AVX2__)
+	for(; x+16<=n; x+=16)
+	{
+		__m256i va = _mm256_loadu_si256((const __m256i *)&a[x]), vb = _mm256_loadu_si256((const __m256i *)&b[x]);
+		_mm256_storeu_si256((__m256i *)&out[x], _mm256_add_epi16(va, vb));
+	}
+#elif defined(__SSE2__)
+	for(; x+8<=n; x+=8)
+	{
+		__m128i va = _mm_loadu_si128((const __m128i *)&a[x]), vb = _mm_loadu_si128((const __m128i *)&b[x]);
+		_mm_storeu_si128((__m128i *)&out[x], _mm_add_epi16(va, vb));
+	}
+#endif
+	for(; x<n; x++)
+		out[x] = a[x] + b[x];
+}
+
+//***************************************************************//
+// One pass: blocks of h rows become blocks of 2h, each worker
+// takes a slice of the output rows
+//***************************************************************//
+static void fht_level_band(void *arg, int index, int count)
+{
+	hough_fht_t *fht = (hough_fht_t *)arg;
+	int q = fht->quadrant, rows = fht->rows[q], cols = fht->cols[q];
+	int h = 1 << (fht->level - 1);
+	const uint16_t *in = fht->buf[(fht->level - 1) & 1];
+	uint16_t *out = fht->buf[fht->level & 1];
+	int r0 = rows * index / count, r1 = rows * (index+1) / count;
+	
+	for(int r=r0; r<r1; r++)
+	{
+		int base = r & ~(2*h - 1), s = r - base, d = (s + 1) >> 1;
+		const uint16_t *top = &in[(unsigned long)(base + (s >> 1)) * cols];
+		const uint16_t *bottom = &in[(unsigned long)(base + h + (s >> 1)) * cols];
+		uint16_t *row = &out[(unsigned long)r * cols];
+		
+		// Past the last column the bottom half of the line has left the image
+		fht_add_row(row, top, bottom + d, cols - d);
+		memcpy(&row[cols - d], &top[cols - d], sizeof(uint16_t) * d);
+	}
+}
+
+//***************************************************************//
+// Cell of the dyadic line of shift s: its theta bin, -1 outside a
+// partial range, and its rho bin (plus 0.5) as a linear function of
+// the start column
+//***************************************************************//
+typedef struct
+{
+	int t;
+	float rho0;				// at column 0
+	float drho;				// per column
+} fht_line_t;
+
+static void fht_line(const hough_fht_t *fht, const hough_t *hough, int q, int s, fht_line_t *line)
+{
+	const hough_params_t *params = &hough->params;
+	double n = fht->rows[q] - 1, w1 = fht->width - 1, h1 = fht->height - 1;
+	double dx, dy, ax, ay, ux, uy;	// direction, first point at column rows, its move per column
+	double len, nx, ny, theta, mid = 0.5 * (params->theta_min + params->theta_max);
+	int t;
+	
+	switch(q)
+	{
+	case 0:  dx = s;  dy = n;  ax = 0;  ay = 0;  ux = 1;  uy = 0;  break;
+	case 1:  dx = -s; dy = n;  ax = w1; ay = 0;  ux = -1; uy = 0;  break;
+	case 2:  dx = n;  dy = s;  ax = 0;  ay = 0;  ux = 0;  uy = 1;  break;
+	default: dx = n;  dy = -s; ax = 0;  ay = h1; ux = 0;  uy = -1; break;
+	}
+	len = sqrt(dx*dx + dy*dy);
+	nx = dy / len;
+	ny = -dx / len;
+	
+	// Into the 180 degrees centred on the theta range, rho changes sign with every half turn
+	theta = atan2(ny, nx) / DEG2RAD;
+	while(theta < mid - 90.0)
+	{
+		theta += 180.0;
+		nx = -nx;
+		ny = -ny;
+	}
+	while(theta >= mid + 90.0)
+	{
+		theta -= 180.0;
+		nx = -nx;
+		ny = -ny;
+	}
+	t = (int)floor((theta - params->theta_min) / params->theta_step + 0.5);
+	if(t >= hough->theta_bins && hough->wraps)
+	{
+		t -= hough->theta_bins;
+		nx = -nx;
+		ny = -ny;
+	}
+	line->t = (t < 0 || t >= hough->theta_bins) ? -1 : t;
+	
+	// Same centre as the kernel; column c starts at u = c - rows
+	ax -= fht->rows[q] * ux + fht->width/2;
+	ay -= fht->rows[q] * uy + fht->height/2;
+	line->rho0 = (float)((nx*ax + ny*ay) / params->rho_step + hough->hough_h + 0.5);
+	line->drho = (float)((nx*ux + ny*uy) / params->rho_step);
+}
+
+static int fht_bin(const hough_fht_t *fht, const hough_t *hough, int q, int s)
+{
+	fht_line_t line;
+	
+	fht_line(fht, hough, q, s, &line);
+	return line.t;
+}
+
+//***************************************************************//
+// Write a finished theta column into the accumulator
+//***************************************************************//
+static void fht_flush(hough_t *hough, uint16_t *column, int t)
+{
+	unsigned int *cell = &hough->acc[t];
+	
+	for(int rho=0; rho<hough->rho_bins; rho++, cell += hough->theta_stride)
+	{
+		if(column[rho] > *cell)
+			*cell = column[rho];
+	}
+	memset(column, 0, sizeof(uint16_t) * hough->rho_bins);
+}
+
+//***************************************************************//
+// Keep the best line of each cell. The theta bin only moves one way
+// with the shift, so the slices of the shifts are moved to where the
+// bin changes and no two workers write the same cell.
+//***************************************************************//
+static void fht_map_band(void *arg, int index, int count)
+{
+	hough_fht_t *fht = (hough_fht_t *)arg;
+	hough_t *hough = fht->hough;
+	int q = fht->quadrant, rows = fht->rows[q], cols = fht->cols[q];
+	const uint16_t *buf = fht->buf[fht->levels[q] & 1];
+	int s0 = rows * index / count, s1 = rows * (index+1) / count;
+	uint16_t *column = &fht->columns[(unsigned long)fht->rho_bins * index];
+	int t = -1;
+	fht_line_t line;
+	
+	memset(column, 0, sizeof(uint16_t) * fht->rho_bins);
+	while(s0 > 0 && s0 < rows && fht_bin(fht, hough, q, s0) == fht_bin(fht, hough, q, s0 - 1))
+		s0++;
+	while(s1 < rows && fht_bin(fht, hough, q, s1) == fht_bin(fht, hough, q, s1 - 1))
+		s1++;
+	
+	for(int s=s0; s<s1; s++)
+	{
+		const uint16_t *row = &buf[(unsigned long)s * cols];
+		
+		fht_line(fht, hough, q, s, &line);
+		if(line.t < 0)
+			continue;
+		if(line.t != t)
+		{
+			if(t >= 0)
+				fht_flush(hough, column, t);
+			t = line.t;
+		}
+		for(int c=0; c<cols; c++)
+		{
+			int rho;
+			
+			if(!row[c])
+				continue;
+			rho = (int)floorf(line.rho0 + c * line.drho);
+			if(rho >= 0 && rho < hough->rho_bins && row[c] > column[rho])
+				column[rho] = row[c];
+		}
+	}
+	if(t >= 0)
+		fht_flush(hough, column, t);
+}
+
+void CPU_hough_fht(hough_fht_t *fht, hough_t *hough, const edge_mask_t *edges)
+{
+	fht->edges = edges;
+	fht->hough = hough;
+	fht->sums = 0;
+	memset(hough->acc, 0, sizeof(unsigned int) * hough->rho_bins * hough->theta_stride);
+	
+	for(int q=0; q<HOUGH_FHT_QUADRANTS; q++)
+	{
+		fht->quadrant = q;
+		workers_run(fht_clear_band, fht);
+		workers_run(fht_load_band, fht);
+		for(fht->level=1; fht->level<=fht->levels[q]; fht->level++)
+			workers_run(fht_level_band, fht);
+		workers_run(fht_map_band, fht);
+		fht->sums += (unsigned long)fht->levels[q] * fht->rows[q] * fht->cols[q];
+	}
+	hough->points = edge_mask_count(edges);
+	hough->votes = fht->sums;
+}
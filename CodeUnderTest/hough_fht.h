@@ -0,0 +1,65 @@
+//*****************************************************************************************//
+//  hough_fht.h - Dyadic Fast Hough Transform (-engine=fht)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	Voting costs edge pixels x angles, so a dense edge map (a screenshot, text) takes
+//	far longer than a sparse one. The dyadic FHT (Brady) sums the edge pixels along
+//	every discrete line of an N row image in log2(N) passes of N x columns additions,
+//	whatever the edge count, which bounds the frame time.
+//
+//	A line of shift s over a block of 2h rows is the line of shift s/2 over the top h
+//	rows plus the one over the bottom h rows, (s+1)/2 columns further on. Starting from
+//	the rows themselves (h = 1, s = 0) every pass doubles h, and after the last one
+//	row s, column c of the buffer holds the edge count of the line from column c on
+//	the first row to column c+s on the last: the lines within 45 degrees of vertical
+//	leaning one way. The image is placed N columns in, so lines that enter it through
+//	a side are there too. The mirrored image gives the other lean, and the transposed
+//	and transposed-mirrored images the lines within 45 degrees of horizontal: four
+//	quadrants with N the padded height for the first two and the padded width for the
+//	others. Counts are at most N, so the buffers are 16 bit.
+//
+//	Each dyadic line is mapped onto the (rho, theta) cell of its own normal, and the
+//	cell keeps the largest count of the lines that fall in it, so hough->acc holds
+//	the best discrete line of every cell and peaks, lists and hough.pgm work unchanged.
+//	The theta bin only moves one way with the shift, so each worker gathers a whole
+//	theta column before writing it out.
+//	The counts are of lines through the padded rows, one pixel per row (or column),
+//	not the votes of CPU_hough.
+//
+//*****************************************************************************************//
+#ifndef HOUGH_FHT_H
+#define HOUGH_FHT_H
+
+#include <stdint.h>
+
+#include "edgemask.h"
+#include "hough_cpu.h"
+
+#define HOUGH_FHT_QUADRANTS	4
+
+typedef struct
+{
+	int width;				// image size
+	int height;
+	int rows[HOUGH_FHT_QUADRANTS];	// N, the padded height of the quadrant's image
+	int levels[HOUGH_FHT_QUADRANTS];	// log2(N)
+	int cols[HOUGH_FHT_QUADRANTS];	// N plus the quadrant's image width
+	uint16_t *buf[2];		// ping-pong, sized for the largest quadrant
+	int rho_bins;
+	uint16_t *columns;		// per worker, best line of each rho of the theta bin being mapped
+	const edge_mask_t *edges;	// current frame, for the band jobs
+	hough_t *hough;
+	int quadrant;			// being summed
+	int level;
+	unsigned long sums;		// additions in the current frame
+} hough_fht_t;
+
+// Allocate for a width x height image, an accumulator of rho_bins rhos and workers threads
+bool hough_fht_alloc(hough_fht_t *fht, int width, int height, int rho_bins, int workers);
+void hough_fht_free(hough_fht_t *fht);
+
+// Sum every dyadic line of edges and keep the best of each cell in hough->acc
+void CPU_hough_fht(hough_fht_t *fht, hough_t *hough, const edge_mask_t *edges);
+
+#endif
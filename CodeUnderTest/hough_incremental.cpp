@@ -0,0 +1,79 @@
+//*****************************************************************************************//
+//  hough_incremental.cpp - Incremental CPU Hough accumulator for continuous mode
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hough_incremental.h"
+
+bool hough_incremental_alloc(hough_incremental_t *inc, int width, int height, int rebuild_every)
+{
+	memset(inc, 0, sizeof(hough_incremental_t));
+	inc->rebuild_every = (rebuild_every < 0) ? 0 : rebuild_every;
+	if(!edge_mask_alloc(&inc->prev, width, height) || !edge_mask_alloc(&inc->added, width, height) ||
+	   !edge_mask_alloc(&inc->removed, width, height))
+	{
+		hough_incremental_free(inc);
+		return false;
+	}
+	return true;
+}
+
+void hough_incremental_free(hough_incremental_t *inc)
+{
+	edge_mask_free(&inc->prev);
+	edge_mask_free(&inc->added);
+	edge_mask_free(&inc->removed);
+}
+
+//***************************************************************//
+// Split the XOR of the two masks into the pixels that appeared and
+// those that vanished, and count both and the new edges
+//***************************************************************//
+static void hough_incremental_diff(hough_incremental_t *inc, const edge_mask_t *edges)
+{
+	unsigned long words = (unsigned long)edges->words_per_row * edges->height;
+	unsigned long added = 0, removed = 0, points = 0;
+	
+	for(unsigned long i=0; i<words; i++)
+	{
+		uint64_t now = edges->bits[i], before = inc->prev.bits[i];
+		uint64_t changed = now ^ before;
+		
+		inc->added.bits[i] = changed & now;
+		inc->removed.bits[i] = changed & before;
+		added += __builtin_popcountll(changed & now);
+		removed += __builtin_popcountll(changed & before);
+		points += __builtin_popcountll(now);
+	}
+	inc->added_count = added;
+	inc->removed_count = removed;
+	inc->points = points;
+}
+
+void CPU_hough_incremental(hough_incremental_t *inc, hough_t *hough, const edge_mask_t *edges)
+{
+	unsigned long words = (unsigned long)edges->words_per_row * edges->height;
+	
+	hough_incremental_diff(inc, edges);
+	inc->rebuilt = !inc->primed || (inc->rebuild_every && inc->frames + 1 >= inc->rebuild_every) ||
+	               inc->added_count + inc->removed_count > inc->points;
+	if(inc->rebuilt)
+	{
+		CPU_hough(hough, edges, NULL);
+		inc->frames = 0;
+	}
+	else
+	{
+		if(!CPU_hough_update(hough, &inc->added, &inc->removed))
+			return;
+		inc->frames++;
+	}
+	memcpy(inc->prev.bits, edges->bits, sizeof(uint64_t) * words);
+	inc->primed = true;
+}
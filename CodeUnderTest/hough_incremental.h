@@ -0,0 +1,47 @@
+//*****************************************************************************************//
+//  hough_incremental.h - Incremental CPU Hough accumulator for continuous mode
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	A fixed camera sees mostly the same edges every frame, and an edge pixel casts
+//	the same votes whenever it is set. The edge mask the accumulator was voted from
+//	is kept, the new mask is XORed against it a word at a time, and only the pixels
+//	that appeared (new & ~old) or vanished (old & ~new) are voted, +1 and -1, into
+//	the accumulator in place (CPU_hough_update). The cost of a frame follows the
+//	change in the scene rather than its content.
+//
+//	The votes are exact integers computed the same way every time, so an update
+//	gives the accumulator a full transform would. A full transform is still run on
+//	the first frame, every rebuild_every frames to bound the effect of anything that
+//	slips through, and whenever more pixels changed than are set, which is cheaper.
+//
+//*****************************************************************************************//
+#ifndef HOUGH_INCREMENTAL_H
+#define HOUGH_INCREMENTAL_H
+
+#include "edgemask.h"
+#include "gradient.h"
+#include "hough_cpu.h"
+
+typedef struct
+{
+	int rebuild_every;		// frames between full transforms, 0 for only when needed
+	int frames;				// frames since the last full transform
+	bool primed;			// prev holds the edges hough->acc was voted from
+	edge_mask_t prev;
+	edge_mask_t added;		// this frame's change
+	edge_mask_t removed;
+	unsigned long points;	// edge pixels in the frame
+	unsigned long added_count;
+	unsigned long removed_count;
+	bool rebuilt;			// the frame was a full transform
+} hough_incremental_t;
+
+// Allocate for a width x height frame, returns false if out of memory
+bool hough_incremental_alloc(hough_incremental_t *inc, int width, int height, int rebuild_every);
+void hough_incremental_free(hough_incremental_t *inc);
+
+// Bring hough->acc up to date with edges, by an update or a full transform
+void CPU_hough_incremental(hough_incremental_t *inc, hough_t *hough, const edge_mask_t *edges);
+
+#endif
@@ -20,6 +20,8 @@
 
 #include <stdio.h>
 #include <math.h>
+
+#include "stencil.h"
  
 #define MAXRGB 			255
 
@@ -33,24 +35,13 @@ __global__ void sobel(u_char * frame_in, u_char * frame_out, int width, int heig
 	long int size = width*height;
 	
 	
-	//Sobel Implementation
-	int Gx[3][3] = {{-1,-2,-1},{0,0,0},{1,2,1}};
-    int Gy[3][3] = {{-1,0,1},{-2,0,2},{-1,0,1}};
+	//Sobel Implementation, G_x is the vertical derivative here
 	int G_x=0,G_y=0,G = 0; 
-	int i=0,j=0;
     if (index < size && (x>1 && y>1) && (x < (width-1) && y < (height-1 ))   ) 
 	{
-	
-		for(i=0;i<3;i++)
-		{
-			for(j=0;j<3;j++)
-			{
-				G_y += (Gy[i][j])*frame_in[(x+j-1)+(width*(y+i-1))];
-				G_x += (Gx[i][j])*frame_in[(x+j-1)+(width*(y+i-1))];
-			}
-		}
+		G_x = stencil_at<sobel_y_op>(frame_in, x, y, width, height);
+		G_y = stencil_at<sobel_x_op>(frame_in, x, y, width, height);
 		
-				
 		G = abs(G_x) + abs(G_y);
 			
 		if(G>MAXRGB)
@@ -70,25 +61,24 @@ void sobel_wrapper(u_char * frame_in, u_char * frame_out, int width, int height,
 	sobel<<<grid,block>>>(frame_in, frame_out,width,height);
 }
 
-__global__ void houghTransform(u_char * frame_in, u_char * frame_out,const int hough_h)
+__global__ void houghTransform(u_char * frame_in, u_char * frame_out,const int hough_h, const float * cos_t, const float * sin_t, const int theta_bins)
 {
 	int x = blockDim.x*blockIdx.x+threadIdx.x;
 	int y = blockDim.y*blockIdx.y+threadIdx.y;
 	int width = gridDim.x*blockDim.x;
 	int height = gridDim.y*blockDim.y;
 	int index = x + y*width;
-	double DEG2RAD = 0.0174533;
 	
-	//double DEG2RAD = 1;
+	// cos_t and sin_t come from hough_tables() scaled by 1/rho_step, see hough_cpu.h
 	double center_x = width/2;
 	double center_y = height/2;   
 
 	if( frame_in[index] > 250 )			//checking for the values greater than 250, has to be modified if we have different threshold 
 	{
-		for(int t=0;t<180;t++)  
+		for(int t=0;t<theta_bins;t++)  
 		{
-		double r = ( ((double)x - center_x) * cos((double)t * DEG2RAD)) + (((double)y - center_y) * sin((double)t * DEG2RAD));		//plotting x and y in ro and theta
-		frame_out[ (int)((round(r + hough_h) * 180.0)) + t]++;
+		double r = ( ((double)x - center_x) * cos_t[t]) + (((double)y - center_y) * sin_t[t]);		//plotting x and y in ro and theta
+		frame_out[ (int)((round(r + hough_h) * theta_bins)) + t]++;
 		
 	
  
@@ -100,9 +90,9 @@ __global__ void houghTransform(u_char * frame_in, u_char * frame_out,const int h
 //***************************************************************//
 // simple wrapper to keep cuda code in just the kernel file.
 //***************************************************************//
-void houghTransform_wrapper(u_char * frame_in, u_char * frame_out, const int hough_h, dim3 grid, dim3 block)
+void houghTransform_wrapper(u_char * frame_in, u_char * frame_out, const int hough_h, const float * cos_t, const float * sin_t, const int theta_bins, dim3 grid, dim3 block)
 {
 	// Complete the Hough transform on the transformed sobel image
-	houghTransform<<<grid,block>>>(frame_in, frame_out, hough_h);
+	houghTransform<<<grid,block>>>(frame_in, frame_out, hough_h, cos_t, sin_t, theta_bins);
 }
 
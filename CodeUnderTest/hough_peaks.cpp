@@ -0,0 +1,275 @@
+//*****************************************************************************************//
+//  hough_peaks.cpp - Top-K line extraction from the CPU Hough accumulator
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "hough_peaks.h"
+#include "workers.h"
+
+bool hough_peaks_alloc(hough_peaks_t *peaks, int max_peaks, int radius, unsigned int min_votes, int workers)
+{
+	memset(peaks, 0, sizeof(hough_peaks_t));
+	peaks->max_peaks = (max_peaks < 1) ? 1 : max_peaks;
+	peaks->radius = (radius < 1) ? 1 : radius;
+	peaks->min_votes = (min_votes < 1) ? 1 : min_votes;
+	peaks->workers = (workers < 1) ? 1 : workers;
+	
+	peaks->heaps = (hough_peak_t *)malloc(sizeof(hough_peak_t) * peaks->max_peaks * peaks->workers);
+	peaks->heap_sizes = (int *)calloc(peaks->workers, sizeof(int));
+	peaks->peaks = (hough_peak_t *)malloc(sizeof(hough_peak_t) * peaks->max_peaks);
+	if(!peaks->heaps || !peaks->heap_sizes || !peaks->peaks)
+	{
+		hough_peaks_free(peaks);
+		return false;
+	}
+	return true;
+}
+
+void hough_peaks_free(hough_peaks_t *peaks)
+{
+	free(peaks->heaps);
+	free(peaks->heap_sizes);
+	free(peaks->peaks);
+	peaks->heaps = peaks->peaks = NULL;
+	peaks->heap_sizes = NULL;
+}
+
+//***************************************************************//
+// Total order on peaks: more votes first, then raster order
+//***************************************************************//
+static inline bool peak_better(const hough_peak_t *a, const hough_peak_t *b)
+{
+	if(a->votes != b->votes)
+		return a->votes > b->votes;
+	if(a->rho_bin != b->rho_bin)
+		return a->rho_bin < b->rho_bin;
+	return a->theta_bin < b->theta_bin;
+}
+
+static int peak_compare(const void *a, const void *b)
+{
+	const hough_peak_t *pa = (const hough_peak_t *)a, *pb = (const hough_peak_t *)b;
+	return peak_better(pa, pb) ? -1 : peak_better(pb, pa) ? 1 : 0;
+}
+
+//***************************************************************//
+// Bounded min-heap, the root is the weakest peak kept so far
+//***************************************************************//
+static void heap_push(hough_peak_t *heap, int *size, int capacity, const hough_peak_t *peak)
+{
+	int i;
+	
+	if(*size < capacity)
+	{
+		// Sift up from the new leaf
+		i = (*size)++;
+		while(i > 0 && peak_better(&heap[(i-1)/2], peak))
+		{
+			heap[i] = heap[(i-1)/2];
+			i = (i-1)/2;
+		}
+		heap[i] = *peak;
+		return;
+	}
+	if(!peak_better(peak, &heap[0]))
+		return;
+	
+	// Replace the root and sift down
+	i = 0;
+	for(;;)
+	{
+		int child = 2*i + 1;
+		if(child >= *size)
+			break;
+		if(child+1 < *size && peak_better(&heap[child], &heap[child+1]))
+			child++;
+		if(!peak_better(peak, &heap[child]))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = *peak;
+}
+
+//***************************************************************//
+// Non-maximum suppression over one band of rho rows
+//***************************************************************//
+struct peaks_args
+{
+	hough_peaks_t *peaks;
+	const hough_t *hough;
+};
+
+static void hough_peaks_band(void *arg, int index, int count)
+{
+	struct peaks_args *job = (struct peaks_args *)arg;
+	hough_peaks_t *peaks = job->peaks;
+	const hough_t *hough = job->hough;
+	const unsigned int *acc = hough->acc;
+	int stride = hough->theta_stride;
+	int thetas = hough->theta_bins;
+	int rhos = hough->rho_bins;
+	int radius = peaks->radius;
+	int r0 = (int)((long)rhos * index / count);
+	int r1 = (int)((long)rhos * (index+1) / count);
+	hough_peak_t *heap = &peaks->heaps[peaks->max_peaks * index];
+	int *size = &peaks->heap_sizes[index];
+	
+	*size = 0;
+	for(int r=r0; r<r1; r++)
+	{
+		for(int t=0; t<thetas; t++)
+		{
+			unsigned long self = (unsigned long)r * stride + t;
+			unsigned int v = acc[self];
+			bool is_peak = true;
+			
+			if(v < peaks->min_votes)
+				continue;
+			
+			// Once the heap is full a cell that cannot displace its weakest peak
+			// needs no suppression test; raster order makes an equal count lose
+			if(*size == peaks->max_peaks && v <= heap[0].votes)
+				continue;
+			for(int dr=-radius; dr<=radius && is_peak; dr++)
+			{
+				for(int dt=-radius; dt<=radius; dt++)
+				{
+					int rr = r + dr, tt = t + dt;
+					unsigned long cell;
+					
+					if(tt < 0 || tt >= thetas)
+					{
+						// Past either end of a full range is the other end with rho mirrored
+						if(!hough->wraps)
+							continue;
+						tt = (tt < 0) ? tt + thetas : tt - thetas;
+						rr = rhos - 1 - rr;
+					}
+					if(rr < 0 || rr >= rhos)
+						continue;
+					cell = (unsigned long)rr * stride + tt;
+					if(cell == self)
+						continue;
+					
+					// Ties go to the first cell in raster order
+					if(acc[cell] > v || (acc[cell] == v && cell < self))
+					{
+						is_peak = false;
+						break;
+					}
+				}
+			}
+			if(is_peak)
+			{
+				hough_peak_t peak;
+				peak.rho = (r - hough->hough_h) * hough->params.rho_step;
+				peak.theta = hough->params.theta_min + t * hough->params.theta_step;
+				peak.votes = v;
+				peak.rho_bin = r;
+				peak.theta_bin = t;
+				heap_push(heap, size, peaks->max_peaks, &peak);
+			}
+		}
+	}
+}
+
+void CPU_hough_peaks(hough_peaks_t *peaks, const hough_t *hough)
+{
+	struct peaks_args job = { peaks, hough };
+	int candidates = 0;
+	
+	if(workers_count() != peaks->workers)
+	{
+		printf("Hough peaks were allocated for %d workers but %d are running.\n", peaks->workers, workers_count());
+		return;
+	}
+	workers_run(hough_peaks_band, &job);
+	
+	// Gather every worker's heap at the front and keep the best K
+	for(int w=0; w<peaks->workers; w++)
+	{
+		memmove(&peaks->heaps[candidates], &peaks->heaps[peaks->max_peaks * w], sizeof(hough_peak_t) * peaks->heap_sizes[w]);
+		candidates += peaks->heap_sizes[w];
+	}
+	qsort(peaks->heaps, candidates, sizeof(hough_peak_t), peak_compare);
+	peaks->count = (candidates < peaks->max_peaks) ? candidates : peaks->max_peaks;
+	memcpy(peaks->peaks, peaks->heaps, sizeof(hough_peak_t) * peaks->count);
+}
+
+float hough_peaks_distance(const hough_peak_t *ref, int ref_count, const hough_peak_t *test, int test_count, float *max_distance)
+{
+	float sum = 0.0f, worst = 0.0f;
+	
+	if(ref_count == 0 || test_count == 0)
+	{
+		*max_distance = ref_count ? -1.0f : 0.0f;
+		return *max_distance;
+	}
+	for(int i=0; i<ref_count; i++)
+	{
+		float best = -1.0f;
+		for(int j=0; j<test_count; j++)
+		{
+			float dr = (float)(ref[i].rho_bin - test[j].rho_bin);
+			float dt = (float)(ref[i].theta_bin - test[j].theta_bin);
+			float d = sqrtf(dr*dr + dt*dt);
+			if(best < 0.0f || d < best)
+				best = d;
+		}
+		sum += best;
+		worst = (best > worst) ? best : worst;
+	}
+	*max_distance = worst;
+	return sum / ref_count;
+}
+
+void hough_peaks_write(const hough_peaks_t *peaks, FILE *fp, bool binary, unsigned long frame)
+{
+	if(binary)
+	{
+		uint32_t header[2] = { (uint32_t)frame, (uint32_t)peaks->count };
+		fwrite(header, sizeof(header), 1, fp);
+		for(int i=0; i<peaks->count; i++)
+		{
+			fwrite(&peaks->peaks[i].rho, sizeof(float), 1, fp);
+			fwrite(&peaks->peaks[i].theta, sizeof(float), 1, fp);
+			fwrite(&peaks->peaks[i].votes, sizeof(uint32_t), 1, fp);
+		}
+	}
+	else
+	{
+		for(int i=0; i<peaks->count; i++)
+			fprintf(fp, "%lu %.2f %.2f %u\n", frame, peaks->peaks[i].rho, peaks->peaks[i].theta, peaks->peaks[i].votes);
+	}
+}
+
+void hough_sparse_dump(const hough_t *hough, unsigned int min_votes, std::string filename)
+{
+	FILE *fp = fopen(filename.c_str(), "w");
+	
+	if(fp == NULL)
+	{
+		printf("Could not open %s.\n", filename.c_str());
+		return;
+	}
+	for(int r=0; r<hough->rho_bins; r++)
+	{
+		const unsigned int *row = &hough->acc[(unsigned long)r * hough->theta_stride];
+		for(int t=0; t<hough->theta_bins; t++)
+		{
+			if(row[t] >= min_votes && row[t] > 0)
+				fprintf(fp, "%.2f %.2f %u\n", (r - hough->hough_h) * hough->params.rho_step,
+				        hough->params.theta_min + t * hough->params.theta_step, row[t]);
+		}
+	}
+	fclose(fp);
+}
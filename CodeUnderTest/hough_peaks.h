@@ -0,0 +1,67 @@
+//*****************************************************************************************//
+//  hough_peaks.h - Top-K line extraction from the CPU Hough accumulator
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	A peak is a cell with at least min_votes votes that is the maximum of the
+//	(2*radius+1)^2 cells around it; ties go to the cell that comes first in raster
+//	order, so a plateau gives one peak. When the theta range is the full 180 degrees
+//	the neighbourhood wraps round theta with rho mirrored, the same line seen from
+//	the other side. Each worker suppresses a band of rho rows and keeps its best
+//	max_peaks in a bounded min-heap; the heaps are merged and sorted at the end, so
+//	the result does not depend on the number of workers.
+//
+//	Line lists are a few bytes per line instead of the whole accumulator:
+//	  text   - one "frame rho theta votes" line per peak, rho in pixels from the
+//	           image centre and theta in degrees, strongest first
+//	  binary - per frame a uint32 frame number and uint32 count, then count records
+//	           of float rho, float theta, uint32 votes (native byte order)
+//
+//*****************************************************************************************//
+#ifndef HOUGH_PEAKS_H
+#define HOUGH_PEAKS_H
+
+#include <stdio.h>
+#include <string>
+
+#include "hough_cpu.h"
+
+typedef struct
+{
+	float rho;				// pixels from the image centre
+	float theta;			// degrees
+	unsigned int votes;
+	int rho_bin;
+	int theta_bin;
+} hough_peak_t;
+
+typedef struct
+{
+	int max_peaks;			// K
+	int radius;				// suppression neighbourhood, cells either side
+	unsigned int min_votes;
+	int workers;
+	hough_peak_t *heaps;	// max_peaks per worker
+	int *heap_sizes;
+	hough_peak_t *peaks;	// the merged top K, strongest first
+	int count;
+} hough_peaks_t;
+
+// Allocate for the top max_peaks peaks found by workers threads
+bool hough_peaks_alloc(hough_peaks_t *peaks, int max_peaks, int radius, unsigned int min_votes, int workers);
+void hough_peaks_free(hough_peaks_t *peaks);
+
+// Find the strongest peaks of hough->acc on the worker threads
+void CPU_hough_peaks(hough_peaks_t *peaks, const hough_t *hough);
+
+// Mean distance, in bins, from each ref peak to the nearest test peak; the largest
+// is returned in max_distance. Both are 0 when ref is empty and -1 when test is.
+float hough_peaks_distance(const hough_peak_t *ref, int ref_count, const hough_peak_t *test, int test_count, float *max_distance);
+
+// Append the peaks of one frame to an open line list
+void hough_peaks_write(const hough_peaks_t *peaks, FILE *fp, bool binary, unsigned long frame);
+
+// Write every cell with at least min_votes votes as a "rho theta votes" text line
+void hough_sparse_dump(const hough_t *hough, unsigned int min_votes, std::string filename);
+
+#endif
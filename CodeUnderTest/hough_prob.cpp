@@ -0,0 +1,124 @@
+//*****************************************************************************************//
+//  hough_prob.cpp - Probabilistic CPU Hough with early termination (-engine=prob)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hough_prob.h"
+
+bool hough_prob_alloc(hough_prob_t *prob, float sample_fraction, unsigned long vote_budget, unsigned int seed,
+                      int peak_radius, int workers)
+{
+	memset(prob, 0, sizeof(hough_prob_t));
+	prob->sample_fraction = (sample_fraction <= 0.0f || sample_fraction > 1.0f) ? 1.0f : sample_fraction;
+	prob->vote_budget = vote_budget;
+	prob->state = hough_random_seed(seed);
+	
+	prob->prev = (hough_peak_t *)malloc(sizeof(hough_peak_t) * HOUGH_PROB_PEAKS);
+	if(!prob->prev || !hough_peaks_alloc(&prob->peaks, HOUGH_PROB_PEAKS, peak_radius, 1, workers))
+	{
+		hough_prob_free(prob);
+		return false;
+	}
+	return true;
+}
+
+void hough_prob_free(hough_prob_t *prob)
+{
+	hough_peaks_free(&prob->peaks);
+	free(prob->prev);
+	prob->prev = NULL;
+}
+
+//***************************************************************//
+// Fisher-Yates steps for positions [begin, end): each swaps in a
+// uniformly drawn point from the ones not yet voted
+//***************************************************************//
+static void hough_prob_shuffle(hough_prob_t *prob, hough_t *hough, unsigned long begin, unsigned long end)
+{
+	unsigned long n = hough->points;
+	
+	for(unsigned long i=begin; i<end; i++)
+	{
+		// High 32 bits scaled to [0, n - i) without a division
+		unsigned long j = i + (unsigned long)(((hough_random(&prob->state) >> 32) * (uint64_t)(n - i)) >> 32);
+		float x = hough->xs[i], y = hough->ys[i];
+		
+		hough->xs[i] = hough->xs[j];
+		hough->ys[i] = hough->ys[j];
+		hough->xs[j] = x;
+		hough->ys[j] = y;
+		if(hough->windowed)
+		{
+			short t = hough->ts[i];
+			hough->ts[i] = hough->ts[j];
+			hough->ts[j] = t;
+		}
+	}
+}
+
+void CPU_hough_prob(hough_prob_t *prob, hough_t *hough, const edge_mask_t *edges, const gradient_t *grad)
+{
+	unsigned long limit, target, voted = 0;
+	int stable = 0;
+	
+	prob->sampled = 0;
+	prob->checkpoints = 0;
+	prob->prev_count = -1;
+	if(!CPU_hough_points(hough, edges, grad))
+		return;
+	
+	// The smaller of the two limits, a windowed point casts about 2k+1 votes
+	limit = (unsigned long)ceil(prob->sample_fraction * hough->points);
+	prob->stop_reason = "sample fraction";
+	if(prob->vote_budget)
+	{
+		unsigned long per_point = hough->windowed ? 2*hough->params.orient_window + 1 : hough->theta_bins;
+		if(prob->vote_budget / per_point < limit)
+		{
+			limit = prob->vote_budget / per_point;
+			prob->stop_reason = "vote budget";
+		}
+	}
+	limit = (limit > hough->points) ? hough->points : limit;
+	target = (hough->points / 32 > HOUGH_PROB_FIRST) ? hough->points / 32 : HOUGH_PROB_FIRST;
+	target = (target > limit) ? limit : target;
+	
+	CPU_hough_add(hough, 0, 0, true);
+	while(voted < limit)
+	{
+		hough_prob_shuffle(prob, hough, voted, target);
+		CPU_hough_add(hough, voted, target, false);
+		voted = target;
+		if(voted >= limit)
+			break;
+		
+		// Checkpoint: have the leading peaks settled?
+		CPU_hough_peaks(&prob->peaks, hough);
+		prob->checkpoints++;
+		if(prob->prev_count == prob->peaks.count && prob->peaks.count > 0)
+		{
+			// On average, so one swap at the tail of the list does not reset it
+			float worst;
+			float moved = hough_peaks_distance(prob->prev, prob->prev_count, prob->peaks.peaks, prob->peaks.count, &worst);
+			stable = (moved < 1.0f) ? stable + 1 : 0;
+		}
+		else
+			stable = 0;
+		memcpy(prob->prev, prob->peaks.peaks, sizeof(hough_peak_t) * prob->peaks.count);
+		prob->prev_count = prob->peaks.count;
+		if(stable >= HOUGH_PROB_STABLE)
+		{
+			prob->stop_reason = "peaks stable";
+			break;
+		}
+		target = (target + target/2 > limit) ? limit : target + target/2;
+	}
+	prob->sampled = voted;
+}
@@ -0,0 +1,68 @@
+//*****************************************************************************************//
+//  hough_prob.h - Probabilistic CPU Hough with early termination (-engine=prob)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	The peaks of a Hough accumulator are already in place long before every edge
+//	point has voted. The compacted points are voted in a random order, drawn with an
+//	incremental Fisher-Yates shuffle from a seeded xorshift64* generator so a run can
+//	be repeated exactly. Voting is done in batches that grow by half each time, and
+//	after every batch the leading HOUGH_PROB_PEAKS peaks are compared with those of
+//	the batch before. Voting stops when they have moved less than one bin on average
+//	for HOUGH_PROB_STABLE checkpoints in a row, when sample_fraction of the points
+//	have voted, or when vote_budget votes have been cast, whichever comes first.
+//
+//	Vote counts are those of the sample, they are not scaled up to the full set.
+//
+//*****************************************************************************************//
+#ifndef HOUGH_PROB_H
+#define HOUGH_PROB_H
+
+#include <stdint.h>
+
+#include "hough_cpu.h"
+#include "hough_peaks.h"
+
+#define HOUGH_PROB_PEAKS	8		// leading peaks watched for stability
+#define HOUGH_PROB_STABLE	2		// checkpoints in a row without them moving
+#define HOUGH_PROB_FIRST	1024	// points in the first batch (or 1/32 of them)
+
+// xorshift64* generator shared by the sampling engines; the state must not be zero
+static inline uint64_t hough_random_seed(unsigned int seed)
+{
+	return (uint64_t)seed * 0x9E3779B97F4A7C15ULL + 1;
+}
+
+static inline uint64_t hough_random(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+typedef struct
+{
+	float sample_fraction;		// vote at most this fraction of the points
+	unsigned long vote_budget;	// and cast at most this many votes, 0 for no limit
+	uint64_t state;				// xorshift64* state, carried across frames
+	hough_peaks_t peaks;		// leading peaks at the latest checkpoint
+	hough_peak_t *prev;			// and at the one before
+	int prev_count;
+	unsigned long sampled;		// points voted in the last frame
+	int checkpoints;
+	const char *stop_reason;	// why the last frame stopped voting
+} hough_prob_t;
+
+// Allocate for workers threads, seed makes the sampling reproducible; the watched
+// peaks are suppressed with peak_radius, as the peaks they are compared with
+bool hough_prob_alloc(hough_prob_t *prob, float sample_fraction, unsigned long vote_budget, unsigned int seed,
+                      int peak_radius, int workers);
+void hough_prob_free(hough_prob_t *prob);
+
+// Vote a random sample of the set pixels of edges into hough->acc
+void CPU_hough_prob(hough_prob_t *prob, hough_t *hough, const edge_mask_t *edges, const gradient_t *grad);
+
+#endif
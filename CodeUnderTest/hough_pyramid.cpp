@@ -0,0 +1,273 @@
+//*****************************************************************************************//
+//  hough_pyramid.cpp - Coarse-to-fine CPU Hough on a Gaussian pyramid (-engine=pyramid)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hough_pyramid.h"
+#include "workers.h"
+
+extern void CPU_pyrdown(unsigned char* imageIn, unsigned char* imageOut, int width, int height);
+
+bool hough_pyramid_alloc(hough_pyramid_t *pyr, int width, int height, const hough_params_t *params,
+                         int levels, int candidates, int refine, int peak_radius, int orient_bins, int workers)
+{
+	hough_params_t coarse_params = *params;
+	int scale;
+	unsigned long window_cells;
+	
+	memset(pyr, 0, sizeof(hough_pyramid_t));
+	pyr->levels = (levels < 1) ? 1 : (levels > HOUGH_PYRAMID_LEVELS) ? HOUGH_PYRAMID_LEVELS : levels;
+	pyr->refine = (refine < 1) ? 1 : refine;
+	scale = 1 << pyr->levels;
+	pyr->rho_window = pyr->refine * scale;
+	pyr->theta_window = pyr->refine;
+	pyr->frame_width = width;
+	pyr->frame_height = height;
+	workers = (workers < 1) ? 1 : workers;
+	
+	// Same angles at the coarse level: a long line a degree or two off a coarser
+	// bin spreads its votes over several rhos and drops out of the candidates.
+	// A coarse rho bin is scale pixels. Every angle is voted. The theta bins
+	// are the full resolution ones, so the candidates are suppressed with the
+	// same peak radius as the final peaks.
+	coarse_params.orient_window = -1;
+	
+	// Each level is the size CPU_pyrdown makes of the one above it
+	pyr->width = width;
+	pyr->height = height;
+	for(int l=0; l<pyr->levels; l++)
+	{
+		pyr->width /= 2;
+		pyr->height /= 2;
+		pyr->images[l] = (unsigned char *)malloc(pyr->width * pyr->height);
+		if(!pyr->images[l])
+		{
+			hough_pyramid_free(pyr);
+			return false;
+		}
+	}
+	window_cells = (unsigned long)(2*pyr->rho_window + 1) * (2*pyr->theta_window + 1);
+	pyr->windows = (unsigned int *)malloc(sizeof(unsigned int) * window_cells * candidates * workers);
+	pyr->band_points = (unsigned long *)calloc(workers, sizeof(unsigned long));
+	pyr->band_votes = (unsigned long *)calloc(workers, sizeof(unsigned long));
+	if(!pyr->windows || !pyr->band_points || !pyr->band_votes ||
+	   !gradient_alloc(&pyr->grad, pyr->width, pyr->height, GRAD_L1, orient_bins) ||
+	   !edge_mask_alloc(&pyr->edges, pyr->width, pyr->height) ||
+	   !hough_alloc(&pyr->coarse, pyr->width, pyr->height, &coarse_params, workers) ||
+	   !hough_peaks_alloc(&pyr->candidates, candidates, peak_radius, 1, workers))
+	{
+		hough_pyramid_free(pyr);
+		return false;
+	}
+	return true;
+}
+
+void hough_pyramid_free(hough_pyramid_t *pyr)
+{
+	for(int l=0; l<HOUGH_PYRAMID_LEVELS; l++)
+	{
+		free(pyr->images[l]);
+		pyr->images[l] = NULL;
+	}
+	free(pyr->windows);
+	free(pyr->band_points);
+	free(pyr->band_votes);
+	pyr->windows = NULL;
+	pyr->band_points = pyr->band_votes = NULL;
+	gradient_free(&pyr->grad);
+	edge_mask_free(&pyr->edges);
+	hough_free(&pyr->coarse);
+	hough_peaks_free(&pyr->candidates);
+}
+
+void hough_pyramid_down(hough_pyramid_t *pyr, unsigned char *image)
+{
+	for(int l=0; l<pyr->levels; l++)
+	{
+		CPU_pyrdown((l == 0) ? image : pyr->images[l-1], pyr->images[l], pyr->frame_width >> l, pyr->frame_height >> l);
+	}
+}
+
+//***************************************************************//
+// CPU_pyrdown leaves its outer rows and columns zero and blurs the
+// zeros into the next ones in at each level, which would read as
+// edges round the frame. Drop levels+1 pixels on every side.
+//***************************************************************//
+static void clear_pyramid_border(edge_mask_t *mask, int levels)
+{
+	unsigned int w = mask->width, h = mask->height, n = levels + 1;
+	
+	for(unsigned int y=0; y<h; y++)
+	{
+		if(y < n || y + n >= h)
+		{
+			memset(edge_mask_row(mask, y), 0, sizeof(uint64_t) * mask->words_per_row);
+			continue;
+		}
+		for(unsigned int x=0; x<n && x<w; x++)
+		{
+			edge_mask_reset(mask, x, y);
+			edge_mask_reset(mask, w-1-x, y);
+		}
+	}
+}
+
+//***************************************************************//
+// Full resolution window of a candidate: centre cell, and for
+// every column the theta bin it reads and whether rho is mirrored
+// because the window wrapped past an end of a 180 degree range
+//***************************************************************//
+static void candidate_centre(const hough_pyramid_t *pyr, const hough_t *hough, const hough_peak_t *peak, int *rc, int *tc)
+{
+	float scale = (float)(1 << pyr->levels);
+	
+	*rc = hough->hough_h + (int)floorf(peak->rho * scale / hough->params.rho_step + 0.5f);
+	*tc = (int)floorf((peak->theta - hough->params.theta_min) / hough->params.theta_step + 0.5f);
+	if(*tc >= hough->theta_bins)
+	{
+		if(hough->wraps)
+		{
+			*tc -= hough->theta_bins;
+			*rc = hough->rho_bins - 1 - *rc;
+		}
+		else
+			*tc = hough->theta_bins - 1;
+	}
+}
+
+static inline bool window_column(const hough_t *hough, int t, int *tt, bool *flip)
+{
+	*flip = false;
+	*tt = t;
+	if(t >= 0 && t < hough->theta_bins)
+		return true;
+	if(!hough->wraps)
+		return false;
+	*tt = (t < 0) ? t + hough->theta_bins : t - hough->theta_bins;
+	*flip = true;
+	return true;
+}
+
+//***************************************************************//
+// Each worker tests its slice of the full resolution points against
+// every candidate and votes the ones that can reach the window into
+// its own set of windows
+//***************************************************************//
+static void hough_pyramid_refine_band(void *arg, int index, int count)
+{
+	hough_pyramid_t *pyr = (hough_pyramid_t *)arg;
+	hough_t *hough = pyr->hough;
+	int R = pyr->rho_window, T = pyr->theta_window, columns = 2*T + 1;
+	unsigned long window_cells = (unsigned long)(2*R + 1) * columns;
+	int candidates = pyr->candidates.count;
+	unsigned int *windows = &pyr->windows[window_cells * pyr->candidates.max_peaks * index];
+	unsigned long p0 = hough->points * index / count;
+	unsigned long p1 = hough->points * (index+1) / count;
+	float offset = (float)hough->hough_h + 0.5f;	// round(r + hough_h), as CPU_hough
+	float span = T * hough->params.theta_step * DEG2RAD;
+	float curve = 0.5f * hough->hough_h * span * span;	// rho bins, second order term over the window
+	unsigned long points = 0, votes = 0;
+	
+	memset(windows, 0, sizeof(unsigned int) * window_cells * candidates);
+	for(int c=0; c<candidates; c++)
+	{
+		unsigned int *window = &windows[window_cells * c];
+		int rc, tc;
+		float cos_c, sin_c;
+		
+		candidate_centre(pyr, hough, &pyr->candidates.peaks[c], &rc, &tc);
+		cos_c = hough->cos_t[tc];
+		sin_c = hough->sin_t[tc];
+		for(unsigned long i=p0; i<p1; i++)
+		{
+			float x = hough->xs[i], y = hough->ys[i];
+			float r0 = x*cos_c + y*sin_c + hough->hough_h;
+			float slope = -x*sin_c + y*cos_c;	// d rho / d theta in bins per radian
+			
+			// The sinusoid cannot move further than this over the window
+			if(fabsf(r0 - rc) > R + 1 + fabsf(slope) * span + curve)
+				continue;
+			points++;
+			for(int dt=-T; dt<=T; dt++)
+			{
+				int tt, rho;
+				bool flip;
+				
+				if(!window_column(hough, tc + dt, &tt, &flip))
+					continue;
+				rho = (int)(x * hough->cos_t[tt] + (y * hough->sin_t[tt] + offset));
+				if(flip)
+					rho = hough->rho_bins - 1 - rho;
+				if(rho < rc - R || rho > rc + R)
+					continue;
+				window[(rho - rc + R) * columns + dt + T]++;
+				votes++;
+			}
+		}
+	}
+	pyr->band_points[index] = points;
+	pyr->band_votes[index] = votes;
+}
+
+void CPU_hough_pyramid(hough_pyramid_t *pyr, hough_t *hough, const edge_mask_t *edges, const gradient_t *grad)
+{
+	int R = pyr->rho_window, T = pyr->theta_window, columns = 2*T + 1;
+	unsigned long window_cells = (unsigned long)(2*R + 1) * columns;
+	unsigned long stride = pyr->candidates.max_peaks * window_cells;
+	
+	// Candidates from the coarse level
+	clear_pyramid_border(&pyr->edges, pyr->levels);
+	CPU_hough(&pyr->coarse, &pyr->edges, NULL);
+	CPU_hough_peaks(&pyr->candidates, &pyr->coarse);
+	
+	// Refine them at full resolution
+	if(!CPU_hough_points(hough, edges, grad))
+		return;
+	pyr->hough = hough;
+	workers_run(hough_pyramid_refine_band, pyr);
+	
+	// Sum the workers' windows into the accumulator; where windows overlap they
+	// count the same cells, so a cell is written rather than added to
+	memset(hough->acc, 0, sizeof(unsigned int) * hough->rho_bins * hough->theta_stride);
+	for(int c=0; c<pyr->candidates.count; c++)
+	{
+		int rc, tc;
+		
+		candidate_centre(pyr, hough, &pyr->candidates.peaks[c], &rc, &tc);
+		for(int dr=-R; dr<=R; dr++)
+		{
+			for(int dt=-T; dt<=T; dt++)
+			{
+				unsigned long cell = window_cells * c + (dr + R) * columns + dt + T;
+				unsigned int sum = 0;
+				int tt, rho = rc + dr;
+				bool flip;
+				
+				if(!window_column(hough, tc + dt, &tt, &flip))
+					continue;
+				if(flip)
+					rho = hough->rho_bins - 1 - rho;
+				if(rho < 0 || rho >= hough->rho_bins)
+					continue;
+				for(int w=0; w<hough->workers; w++)
+					sum += pyr->windows[stride * w + cell];
+				hough->acc[(unsigned long)rho * hough->theta_stride + tt] = sum;
+			}
+		}
+	}
+	
+	pyr->refined = pyr->votes = 0;
+	for(int w=0; w<hough->workers; w++)
+	{
+		pyr->refined += pyr->band_points[w];
+		pyr->votes += pyr->band_votes[w];
+	}
+	hough->votes = pyr->coarse.votes + pyr->votes;
+}
@@ -0,0 +1,68 @@
+//*****************************************************************************************//
+//  hough_pyramid.h - Coarse-to-fine CPU Hough on a Gaussian pyramid (-engine=pyramid)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	The frame is reduced levels times with CPU_pyrdown (pyramid_kernel.cu), and the
+//	caller finds edges on the smallest image with its usual gradient / Canny stage.
+//	A full Hough of that image, over the same angles but with rho bins 2^levels
+//	pixels wide, gives the candidates: the strongest peaks, in the units of the
+//	full image. Only narrow windows of +/-refine coarse bins around each candidate
+//	are then voted at full resolution. A full resolution point is tested against a
+//	candidate with one rho and a bound on how far its sinusoid can move over the
+//	window, so most points are rejected at a couple of multiply-adds each instead
+//	of voting every angle.
+//
+//	Each window is an exact count of its cells, so after a frame hough->acc holds
+//	the full resolution votes inside the windows and zero everywhere else; peaks,
+//	line lists and hough.pgm work on it unchanged. Lines that do not show at the
+//	coarse scale, or beyond the strongest candidates, are not found.
+//
+//*****************************************************************************************//
+#ifndef HOUGH_PYRAMID_H
+#define HOUGH_PYRAMID_H
+
+#include "edgemask.h"
+#include "gradient.h"
+#include "hough_cpu.h"
+#include "hough_peaks.h"
+
+#define HOUGH_PYRAMID_LEVELS	3		// most pyrdown levels
+
+typedef struct
+{
+	int levels;				// pyrdown levels, the coarse image is 2^levels smaller
+	int refine;				// coarse bins refined either side of a candidate
+	int rho_window;			// the same in full resolution bins, refine*2^levels
+	int theta_window;		// and refine
+	int frame_width;		// full resolution frame, the stride of the image given to hough_pyramid_down
+	int frame_height;
+	int width;				// coarse image size, frame size halved (rounding down) at each level
+	int height;
+	unsigned char *images[HOUGH_PYRAMID_LEVELS];	// each level, the last one is coarsest
+	gradient_t grad;		// filled by the caller from the coarsest image
+	edge_mask_t edges;
+	hough_t coarse;
+	hough_peaks_t candidates;
+	unsigned int *windows;	// one (2*rho_window+1) x (2*theta_window+1) count per candidate
+	unsigned long *band_points;	// points each worker refined
+	unsigned long *band_votes;
+	hough_t *hough;			// full resolution transform of the current frame
+	unsigned long refined;	// point/candidate pairs that passed the test
+	unsigned long votes;	// full resolution votes cast
+} hough_pyramid_t;
+
+// Allocate for a width x height frame: levels reductions, up to candidates lines
+// refined +/-refine coarse bins and suppressed with peak_radius, a coarse gradient
+// with orient_bins orientations
+bool hough_pyramid_alloc(hough_pyramid_t *pyr, int width, int height, const hough_params_t *params,
+                         int levels, int candidates, int refine, int peak_radius, int orient_bins, int workers);
+void hough_pyramid_free(hough_pyramid_t *pyr);
+
+// Build the pyramid of a frame; the caller then fills pyr->edges from the last level
+void hough_pyramid_down(hough_pyramid_t *pyr, unsigned char *image);
+
+// Find the candidates on pyr->edges and refine them at full resolution into hough->acc
+void CPU_hough_pyramid(hough_pyramid_t *pyr, hough_t *hough, const edge_mask_t *edges, const gradient_t *grad);
+
+#endif
@@ -0,0 +1,241 @@
+//*****************************************************************************************//
+//  hough_segments.cpp - Progressive probabilistic Hough line segments (-engine=ppht)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hough_segments.h"
+#include "hough_prob.h"
+
+#define WALK_SHIFT	16			// fixed point fraction bits of the line walk
+
+bool hough_segments_alloc(hough_segments_t *seg, int width, int height, unsigned int threshold,
+                          int min_length, int max_gap, unsigned int seed)
+{
+	memset(seg, 0, sizeof(hough_segments_t));
+	seg->threshold = (threshold < 1) ? 1 : threshold;
+	seg->min_length = (min_length < 0) ? 0 : min_length;
+	seg->max_gap = (max_gap < 0) ? 0 : max_gap;
+	seg->state = hough_random_seed(seed);
+	
+	seg->segments = (hough_segment_t *)malloc(sizeof(hough_segment_t) * HOUGH_SEGMENTS_MAX);
+	if(!seg->segments ||
+	   !edge_mask_alloc(&seg->mask, width, height) || !edge_mask_alloc(&seg->voted, width, height))
+	{
+		hough_segments_free(seg);
+		return false;
+	}
+	return true;
+}
+
+void hough_segments_free(hough_segments_t *seg)
+{
+	free(seg->segments);
+	seg->segments = NULL;
+	edge_mask_free(&seg->mask);
+	edge_mask_free(&seg->voted);
+}
+
+//***************************************************************//
+// Add (or with sign -1 take back) the votes of one point, returns
+// the largest count it reached and its theta bin in best_t
+//***************************************************************//
+static unsigned int segments_vote(hough_t *hough, int x, int y, int sign, int *best_t)
+{
+	float fx = (float)(x - hough->width/2), fy = (float)(y - hough->height/2);
+	float offset = (float)hough->hough_h + 0.5f;	// round(r + hough_h), as CPU_hough
+	int stride = hough->theta_stride;
+	unsigned int best = 0;
+	
+	for(int t=0; t<hough->theta_bins; t++)
+	{
+		int rho = (int)(fx * hough->cos_t[t] + (fy * hough->sin_t[t] + offset));
+		unsigned int *cell = &hough->acc[rho * stride + t];
+		
+		*cell += sign;
+		if(*cell > best)
+		{
+			best = *cell;
+			*best_t = t;
+		}
+	}
+	return best;
+}
+
+//***************************************************************//
+// A line through a point, stepped one pixel at a time along its
+// major axis with the minor axis in fixed point
+//***************************************************************//
+typedef struct
+{
+	bool x_major;
+	int dx, dy;			// per step, the minor axis in WALK_SHIFT fixed point
+	int x, y;			// start, the minor axis in fixed point
+} walk_t;
+
+static void walk_setup(walk_t *walk, int x, int y, float theta_deg)
+{
+	// The line runs along (-sin, cos) of its normal
+	double theta = theta_deg * DEG2RAD;
+	double a = -sin(theta), b = cos(theta);
+	
+	walk->x_major = fabs(a) > fabs(b);
+	if(walk->x_major)
+	{
+		walk->dx = (a > 0) ? 1 : -1;
+		walk->dy = (int)floor(b * (1 << WALK_SHIFT) / fabs(a) + 0.5);
+		walk->x = x;
+		walk->y = (y << WALK_SHIFT) + (1 << (WALK_SHIFT-1));
+	}
+	else
+	{
+		walk->dy = (b > 0) ? 1 : -1;
+		walk->dx = (int)floor(a * (1 << WALK_SHIFT) / fabs(b) + 0.5);
+		walk->x = (x << WALK_SHIFT) + (1 << (WALK_SHIFT-1));
+		walk->y = y;
+	}
+}
+
+//***************************************************************//
+// Walk in direction k (0 or 1) until max_gap unset pixels in a row
+// or the image edge and return the last set pixel in (ex, ey). With
+// consume, every set pixel up to (ex, ey) is cleared instead, and
+// when unvote is true its votes are taken back.
+//***************************************************************//
+static void walk_line(hough_segments_t *seg, hough_t *hough, const walk_t *walk, int k,
+                      int *ex, int *ey, bool consume, bool unvote)
+{
+	int dx = k ? -walk->dx : walk->dx, dy = k ? -walk->dy : walk->dy;
+	int x = walk->x, y = walk->y;
+	int gap = 0, t;
+	
+	for(;; x += dx, y += dy)
+	{
+		int px = walk->x_major ? x : x >> WALK_SHIFT;
+		int py = walk->x_major ? y >> WALK_SHIFT : y;
+		
+		if(px < 0 || px >= (int)seg->mask.width || py < 0 || py >= (int)seg->mask.height)
+			break;
+		if(edge_mask_get(&seg->mask, px, py))
+		{
+			if(consume)
+			{
+				edge_mask_reset(&seg->mask, px, py);
+				seg->consumed++;
+				if(unvote && edge_mask_get(&seg->voted, px, py))
+				{
+					segments_vote(hough, px, py, -1, &t);
+					edge_mask_reset(&seg->voted, px, py);
+				}
+			}
+			else
+			{
+				gap = 0;
+				*ex = px;
+				*ey = py;
+			}
+		}
+		else if(!consume && ++gap > seg->max_gap)
+			break;
+		if(consume && px == *ex && py == *ey)
+			break;
+	}
+}
+
+void CPU_hough_segments(hough_segments_t *seg, hough_t *hough, const edge_mask_t *edges)
+{
+	float cx = (float)(hough->width/2), cy = (float)(hough->height/2);
+	unsigned long n;
+	
+	// Work on a copy, walks clear the points they take
+	memcpy(seg->mask.bits, edges->bits, sizeof(uint64_t) * edges->words_per_row * edges->height);
+	edge_mask_clear(&seg->voted);
+	memset(hough->acc, 0, sizeof(unsigned int) * hough->rho_bins * hough->theta_stride);
+	seg->count = 0;
+	seg->visited = seg->consumed = 0;
+	
+	// Shuffle the compacted points into visiting order
+	n = hough_compact_points(hough, edges);
+	for(unsigned long i=n; i>1; i--)
+	{
+		unsigned long j = (unsigned long)(((hough_random(&seg->state) >> 32) * (uint64_t)i) >> 32);
+		float x = hough->xs[i-1], y = hough->ys[i-1];
+		hough->xs[i-1] = hough->xs[j];
+		hough->ys[i-1] = hough->ys[j];
+		hough->xs[j] = x;
+		hough->ys[j] = y;
+	}
+	seg->points = n;
+	
+	for(unsigned long i=0; i<n && seg->count < HOUGH_SEGMENTS_MAX; i++)
+	{
+		int x = (int)(hough->xs[i] + cx), y = (int)(hough->ys[i] + cy);
+		int best_t = 0, ex[2], ey[2];
+		unsigned int votes;
+		bool good;
+		walk_t walk;
+		
+		// Already taken by an earlier walk
+		if(!edge_mask_get(&seg->mask, x, y))
+			continue;
+		votes = segments_vote(hough, x, y, 1, &best_t);
+		edge_mask_set(&seg->voted, x, y);
+		seg->visited++;
+		if(votes < seg->threshold)
+			continue;
+		
+		// Find the end points, then take every point between them
+		walk_setup(&walk, x, y, hough->params.theta_min + best_t * hough->params.theta_step);
+		for(int k=0; k<2; k++)
+		{
+			ex[k] = x;
+			ey[k] = y;
+			walk_line(seg, hough, &walk, k, &ex[k], &ey[k], false, false);
+		}
+		good = abs(ex[1] - ex[0]) >= seg->min_length || abs(ey[1] - ey[0]) >= seg->min_length;
+		for(int k=0; k<2; k++)
+			walk_line(seg, hough, &walk, k, &ex[k], &ey[k], true, good);
+		
+		if(good)
+		{
+			hough_segment_t *s = &seg->segments[seg->count++];
+			s->x0 = ex[0];
+			s->y0 = ey[0];
+			s->x1 = ex[1];
+			s->y1 = ey[1];
+			s->votes = votes;
+		}
+	}
+	hough->points = n;
+	hough->votes = seg->visited * hough->theta_bins;
+}
+
+void hough_segments_write(const hough_segments_t *seg, FILE *fp, bool binary, unsigned long frame)
+{
+	if(binary)
+	{
+		uint32_t header[2] = { (uint32_t)frame, (uint32_t)seg->count };
+		fwrite(header, sizeof(header), 1, fp);
+		for(int i=0; i<seg->count; i++)
+		{
+			const hough_segment_t *s = &seg->segments[i];
+			int32_t ends[4] = { s->x0, s->y0, s->x1, s->y1 };
+			fwrite(ends, sizeof(ends), 1, fp);
+			fwrite(&s->votes, sizeof(uint32_t), 1, fp);
+		}
+	}
+	else
+	{
+		for(int i=0; i<seg->count; i++)
+		{
+			const hough_segment_t *s = &seg->segments[i];
+			fprintf(fp, "%lu %d %d %d %d %u\n", frame, s->x0, s->y0, s->x1, s->y1, s->votes);
+		}
+	}
+}
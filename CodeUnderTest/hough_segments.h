@@ -0,0 +1,72 @@
+//*****************************************************************************************//
+//  hough_segments.h - Progressive probabilistic Hough line segments (-engine=ppht)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	Finds finite segments instead of (rho, theta) lines, after Matas, Galambos and
+//	Kittler's progressive probabilistic Hough transform. The edge points are visited
+//	in a random order (seeded, so a run can be repeated) and each one votes every
+//	angle into hough->acc. As soon as a vote lifts a cell to threshold the line
+//	through that point is walked both ways in the edge mask, bridging gaps of up to
+//	max_gap pixels, to find the segment's end points. Every point the walk passes is
+//	consumed: it is cleared from the working mask so it is never visited again, and
+//	when the segment is at least min_length pixels long along x or y it is kept and
+//	the votes its points had already cast are taken back out of the accumulator.
+//	The work shrinks as the image is explained, and points on a found line cannot
+//	vote for it again.
+//
+//	The walk is inherently sequential, so this runs on the calling thread. After a
+//	frame hough->acc holds the votes of the points that were visited but belong to
+//	no segment.
+//
+//	Segment lists, like the line lists of hough_peaks.h:
+//	  text   - one "frame x0 y0 x1 y1 votes" line per segment, in pixels
+//	  binary - per frame a uint32 frame number and uint32 count, then count records
+//	           of int32 x0, y0, x1, y1 and uint32 votes (native byte order)
+//
+//*****************************************************************************************//
+#ifndef HOUGH_SEGMENTS_H
+#define HOUGH_SEGMENTS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "edgemask.h"
+#include "hough_cpu.h"
+
+#define HOUGH_SEGMENTS_MAX	4096	// segments kept per frame
+
+typedef struct
+{
+	int x0, y0;				// end points, pixels
+	int x1, y1;
+	unsigned int votes;		// votes of the cell that found it
+} hough_segment_t;
+
+typedef struct
+{
+	unsigned int threshold;	// votes that trigger a walk
+	int min_length;			// pixels along x or y
+	int max_gap;			// unset pixels bridged by the walk
+	uint64_t state;			// random order, carried across frames
+	edge_mask_t mask;		// points not yet consumed
+	edge_mask_t voted;		// points whose votes are in the accumulator
+	hough_segment_t *segments;
+	int count;
+	unsigned long points;	// edge points in the frame
+	unsigned long visited;	// points that voted
+	unsigned long consumed;	// points taken by walks
+} hough_segments_t;
+
+// Allocate for a width x height image, seed makes the visiting order reproducible
+bool hough_segments_alloc(hough_segments_t *seg, int width, int height, unsigned int threshold,
+                          int min_length, int max_gap, unsigned int seed);
+void hough_segments_free(hough_segments_t *seg);
+
+// Find the segments of edges, voting into hough->acc
+void CPU_hough_segments(hough_segments_t *seg, hough_t *hough, const edge_mask_t *edges);
+
+// Append the segments of one frame to an open segment list
+void hough_segments_write(const hough_segments_t *seg, FILE *fp, bool binary, unsigned long frame);
+
+#endif
@@ -0,0 +1,103 @@
+//*****************************************************************************************//
+//  perfcount.cpp - Per worker hardware cache miss counters (Linux perf_event_open)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perfcount.h"
+#include "workers.h"
+
+#if defined(__linux__)
+//***************************************************************//
+// User space only counter of the calling thread on any CPU
+//***************************************************************//
+static int perf_open(unsigned int type, unsigned long long config)
+{
+	struct perf_event_attr attr;
+	
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void perf_open_band(void *arg, int index, int count)
+{
+	perf_counters_t *pc = (perf_counters_t *)arg;
+	
+	(void)count;	// one counter pair per worker, nothing to split
+	pc->l1d_fds[index] = perf_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+	                               (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	pc->llc_fds[index] = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	if(index == 0 && pc->llc_fds[0] < 0)
+		snprintf(pc->reason, sizeof(pc->reason), "perf_event_open: %s", strerror(errno));
+}
+#endif
+
+bool perf_counters_open(perf_counters_t *pc)
+{
+	memset(pc, 0, sizeof(perf_counters_t));
+	pc->workers = workers_count();
+	for(int w=0; w<PERF_MAX_WORKERS; w++)
+		pc->l1d_fds[w] = pc->llc_fds[w] = -1;
+#if defined(__linux__)
+	if(pc->workers > PERF_MAX_WORKERS)
+	{
+		snprintf(pc->reason, sizeof(pc->reason), "more than %d workers", PERF_MAX_WORKERS);
+		return false;
+	}
+	workers_run(perf_open_band, pc);
+	for(int w=0; w<pc->workers; w++)
+		pc->available = pc->available || pc->l1d_fds[w] >= 0 || pc->llc_fds[w] >= 0;
+	if(!pc->available && pc->reason[0] == 0)
+		snprintf(pc->reason, sizeof(pc->reason), "no cache events");
+#else
+	snprintf(pc->reason, sizeof(pc->reason), "perf_event_open is Linux only");
+#endif
+	return pc->available;
+}
+
+void perf_counters_close(perf_counters_t *pc)
+{
+	for(int w=0; w<PERF_MAX_WORKERS; w++)
+	{
+		if(pc->l1d_fds[w] >= 0)
+			close(pc->l1d_fds[w]);
+		if(pc->llc_fds[w] >= 0)
+			close(pc->llc_fds[w]);
+		pc->l1d_fds[w] = pc->llc_fds[w] = -1;
+	}
+	pc->available = false;
+}
+
+static unsigned long long perf_sum(const int *fds, int workers)
+{
+	unsigned long long sum = 0;
+	
+	for(int w=0; w<workers; w++)
+	{
+		unsigned long long value;
+		if(fds[w] >= 0 && read(fds[w], &value, sizeof(value)) == sizeof(value))
+			sum += value;
+	}
+	return sum;
+}
+
+void perf_counters_read(const perf_counters_t *pc, perf_sample_t *sample)
+{
+	sample->l1d_misses = perf_sum(pc->l1d_fds, pc->workers);
+	sample->llc_misses = perf_sum(pc->llc_fds, pc->workers);
+}
@@ -0,0 +1,41 @@
+//*****************************************************************************************//
+//  perfcount.h - Per worker hardware cache miss counters (Linux perf_event_open)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	Each worker thread opens its own user space counters for L1 data cache read
+//	misses and last level cache misses, so a stage run with workers_run() can be
+//	measured by reading the sums before and after it. The workers sleep between
+//	jobs, so reading from the calling thread is exact enough. Where the kernel or
+//	the machine (a VM, perf_event_paranoid > 2) has no hardware counters the
+//	counter stays closed and the reason is kept for the report.
+//
+//*****************************************************************************************//
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#define PERF_MAX_WORKERS	64
+
+typedef struct
+{
+	int workers;
+	int l1d_fds[PERF_MAX_WORKERS];	// -1 where the event could not be opened
+	int llc_fds[PERF_MAX_WORKERS];
+	bool available;
+	char reason[128];		// why not, when it is not
+} perf_counters_t;
+
+typedef struct
+{
+	unsigned long long l1d_misses;
+	unsigned long long llc_misses;
+} perf_sample_t;
+
+// Open the counters on every running worker, false (with pc->reason) if none could be
+bool perf_counters_open(perf_counters_t *pc);
+void perf_counters_close(perf_counters_t *pc);
+
+// Sum of every worker's counts so far
+void perf_counters_read(const perf_counters_t *pc, perf_sample_t *sample);
+
+#endif
@@ -247,6 +247,24 @@ dump_ppm_data(std::string filename, unsigned int width, unsigned int height, uns
   }
 } 
 
+// Dump a packed bitmap in PBM (P4) format. Rows are (width+7)/8 bytes,
+// leftmost pixel in the most significant bit, set bits are black.
+void 
+dump_pbm_data(std::string filename, unsigned int width, unsigned int height, unsigned char *data) {
+
+  FILE *f = fopen(filename.c_str(), "wb");
+  
+#ifdef DEBUG
+  std::cout << "Dumping " << filename << std::endl;
+#endif
+
+  if (f != NULL) {
+    fprintf(f, "P4\n%s\n%d %d\n", PPM_COMMENT, width, height);
+    fwrite(data, 1, ((width + 7) / 8) * height, f);
+    fclose(f);
+  }
+}
+
 /* Siewert */
 bool readppm(unsigned char *buffer, int *bufferlen, 
              char *header, int *headerlen,
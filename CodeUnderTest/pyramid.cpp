@@ -468,7 +468,7 @@ int main(int argc, char* argv[])
 		exit(EXIT_IMG_SZ);
 	}
 
-	input_image = (unsigned char *)malloc(sizeof(unsigned int) * img_width * img_height);
+	input_image = (unsigned char *)malloc(sizeof(unsigned char) * img_width * img_height * img_chan);
 	readppm(input_image, &tempInt, 
              tempChar, &tempInt,
              &img_height, &img_width, &img_chan,
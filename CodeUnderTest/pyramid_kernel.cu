@@ -20,6 +20,9 @@
 #ifndef _PYRAMID_KERNEL_H_
 #define _PYRAMID_KERNEL_H_
 
+#include <stdlib.h>
+#include <string.h>
+
 #define min(a,b) (((a)<(b))?(a):(b))
 #define max(a,b) (((a)>(b))?(a):(b))
 #define CLAMP_8bit(x) max(0, min(255, (x)))
@@ -252,51 +255,77 @@ void PyrUp(unsigned char* g_DataIn, unsigned char* g_DataOut, int width, int hei
  ***************************************************************************************************/
 void CPU_pyrdown(unsigned char* imageIn, unsigned char* imageOut, int width, int height)
 {
-  int i, j, rows, cols, startCol, endCol, startRow, endRow;
-  const float gaussianMatrix[25] = {1,4,6,4,1,4,16,24,16,4,6,24,36,24,6,4,16,24,16,4,1,4,6,4,1};
+  // The 5x5 kernel is [1 4 6 4 1] across times [1 4 6 4 1] down, so each kept row is
+  // filtered across at the even columns only, into a ring of 5 rows of 16 bit sums
+  // (at most 255*16), and each output pixel is then 5 of them summed down. The sum
+  // is at most 255*256 and >>8 floors it exactly as sumX/256 did. Only the quarter of
+  // the pixels the subsampling keeps is filtered: two new ring entries and one sum
+  // down per output pixel, in shifts and adds, where every input pixel used to get a
+  // 25-tap float convolution.
+  static unsigned short* ring = NULL;
+  static int ringCols = 0;
+  int i, j, r, outCols, outRows, startCol, endCol, endRow;
+
+  outCols = width/2;
+  outRows = height/2;
+
+  // Kept across calls, the pyramid asks for the same sizes every frame
+  if(outCols > ringCols) {
+    free(ring);
+    ring = (unsigned short *)malloc(sizeof(unsigned short) * FILTER_DIAMETER * outCols);
+    ringCols = outCols;
+  }
 
-  rows = height;
-  cols = width;
+  // Same borders as the full convolution: rows and columns within FILTER_RADIUS of
+  // the edge were never filtered and stay zero
+  startCol = 1;
+  endCol = (width - FILTER_RADIUS + 1) / 2;
+  endRow = (height - FILTER_RADIUS + 1) / 2;
+  if(endCol > outCols) endCol = outCols;
+  if(endRow > outRows) endRow = outRows;
 
-  unsigned char* gaussimage = (unsigned char *)malloc(width * height);
+  for(i=0; i<outRows; i++) {
+    unsigned char* out = &imageOut[i*outCols];
 
-  // Initialize all output pixels to zero
-  for(i=0; i<rows; i++) {
-    for(j=0; j<cols; j++) {
-    	gaussimage[i*width + j] = 0;
+    if(i < 1 || i >= endRow || startCol >= endCol) {
+      memset(out, 0, outCols);
+      continue;
     }
-  }
-
-  startCol = FILTER_RADIUS;
-  endCol = cols - FILTER_RADIUS;
-  startRow = FILTER_RADIUS;
-  endRow = rows - FILTER_RADIUS;
 
-  // Loop for each pixel
-  for(i=startRow; i<endRow; i++) {
-    for(j=startCol; j<endCol; j++) {
-       // convolution of the image with the filter
-       float sumX = 0;
-       int dy;
-       for(dy = -FILTER_RADIUS; dy <= FILTER_RADIUS; dy++) {
-    	   int dx;
-          for(dx = -FILTER_RADIUS; dx <= FILTER_RADIUS; dx++) {
-             float Pixel = (float)(imageIn[i*width + j +  (dy * width + dx)]);
-             sumX += Pixel * gaussianMatrix[(dy + FILTER_RADIUS) * FILTER_DIAMETER + (dx+FILTER_RADIUS)];
-          }
-	}
-       gaussimage[i*width + j] = CLAMP_8bit(sumX/256);
+    // Rows 2i-2 .. 2i+2, the first three are already in the ring after the first output row
+    for(r = (i == 1) ? 2*i - FILTER_RADIUS : 2*i + 1; r <= 2*i + FILTER_RADIUS; r++) {
+      const unsigned char* in = &imageIn[r*width];
+      unsigned short* h = &ring[(r % FILTER_DIAMETER) * outCols];
+      for(j=startCol; j<endCol; j++) {
+        const unsigned char* p = &in[2*j];
+        h[j] = p[-2] + p[2] + ((p[-1] + p[1]) << 2) + (p[0] << 2) + (p[0] << 1);
+      }
     }
-  }
 
-  //sub-sampling
-  for(i=0; i<height/2; i++) {
-    for(j=0; j<width/2; j++) {
-    	imageOut[i*(width/2) + j] = gaussimage[i*width*2 + j*2];
+    const unsigned short* h0 = &ring[((2*i - 2) % FILTER_DIAMETER) * outCols];
+    const unsigned short* h1 = &ring[((2*i - 1) % FILTER_DIAMETER) * outCols];
+    const unsigned short* h2 = &ring[((2*i) % FILTER_DIAMETER) * outCols];
+    const unsigned short* h3 = &ring[((2*i + 1) % FILTER_DIAMETER) * outCols];
+    const unsigned short* h4 = &ring[((2*i + 2) % FILTER_DIAMETER) * outCols];
+    out[0] = 0;
+    for(j=startCol; j<endCol; j++) {
+      unsigned int sum = h0[j] + h4[j] + ((h1[j] + h3[j]) << 2) + (h2[j] << 2) + (h2[j] << 1);
+      out[j] = (unsigned char)(sum >> 8);
     }
+    for(j=endCol; j<outCols; j++)
+      out[j] = 0;
   }
+}
 
-  free(gaussimage);
+// Input column x of the rows an output row reads, summed down with that row's
+// phase of the kernel: [1 6 1] on three rows for even output rows, [4 4] on two
+// for odd ones (r2 unused)
+static inline int pyrup_column(const unsigned char* r0, const unsigned char* r1, const unsigned char* r2,
+                               int oddRow, int x)
+{
+  if(oddRow)
+    return (r0[x] + r1[x]) << 2;
+  return r0[x] + r2[x] + (r1[x] << 2) + (r1[x] << 1);
 }
 
 /***************************************************************************************************
@@ -305,63 +334,41 @@ void CPU_pyrdown(unsigned char* imageIn, unsigned char* imageOut, int width, int
  ***************************************************************************************************/
 void CPU_pyrup(unsigned char* imageIn, unsigned char* imageOut, int width, int height)
 {
-  int i, j, rows, cols, startCol, endCol, startRow, endRow;
-  const float laplacianMatrix[25] = {1,4,6,4,1,4,16,24,16,4,6,24,36,24,6,4,16,24,16,4,1,4,6,4,1};
-
-  rows = height;
-  cols = width;
-
-  unsigned char* laplaceimage = (unsigned char *)malloc(width*2 * height*2);
-
-  // super-sampling
-  // Insert 0s between columns
-  for(i=0; i<rows*2; i=i+2) {
-    for(j=1; j<cols*2; j=j+2) {
-    	laplaceimage[i*width*2 + j] = 0;
+  // Upsampling by zero insertion puts a zero at three output positions in four, so of
+  // the 25 taps only 9, 6, 6 or 4 ever meet an input pixel, depending on whether the
+  // output row and column are even or odd. Those taps are read straight from the input:
+  // down [1 6 1] or [4 4], then across [1 6 1] or [4 4]. Each phase sums to 64, so >>6
+  // floors exactly as sumX/64 did, and pixels within FILTER_RADIUS of the edge are left
+  // unwritten as before.
+  int i, b, outWidth, endRow;
+
+  // Nothing is written unless there is an input column and row on both sides
+  if(width < 3 || height < 3)
+    return;
+
+  outWidth = width*2;
+  endRow = height*2 - FILTER_RADIUS;
+
+  for(i=FILTER_RADIUS; i<endRow; i++) {
+    int a = i >> 1, oddRow = i & 1;
+    const unsigned char* r0 = &imageIn[(oddRow ? a : a - 1)*width];
+    const unsigned char* r1 = &imageIn[(oddRow ? a + 1 : a)*width];
+    const unsigned char* r2 = &imageIn[(a + 1)*width];
+    unsigned char* out = &imageOut[i*outWidth];
+    int vm = pyrup_column(r0, r1, r2, oddRow, 0);
+    int v0 = pyrup_column(r0, r1, r2, oddRow, 1);
+
+    // Output columns 2b and 2b+1, from input columns b-1, b and b+1
+    for(b=1; b<width-1; b++) {
+      int vp = pyrup_column(r0, r1, r2, oddRow, b + 1);
+      out[2*b]     = CLAMP_8bit((vm + vp + (v0 << 2) + (v0 << 1)) >> 6);
+      out[2*b + 1] = CLAMP_8bit(((v0 + vp) << 2) >> 6);
+      vm = v0;
+      v0 = vp;
     }
   }
-
-  // Insert 0s between rows
-  for(i=1; i<rows*2; i=i+2) {
-    for(j=0; j<cols*2; j++) {
-    	laplaceimage[i*width*2 + j] = 0;
-    }
-  }
-
-  int x=0,y=0;
-  // Insert pixels from input image
-  for(i=0; i<rows*2; i++,i++,x++) {
-	  y=0;
-    for(j=0; j<cols*2; j++,j++,y++) {
-    	laplaceimage[i*width*2 + j] = imageIn[x*width + y];
-    }
-  }
-
-  startCol = FILTER_RADIUS;
-  endCol = cols*2 - FILTER_RADIUS;
-  startRow = FILTER_RADIUS;
-  endRow = rows*2 - FILTER_RADIUS;
-
-  // Loop for each pixel
-  for(i=startRow; i<endRow; i++) {
-    for(j=startCol; j<endCol; j++) {
-        // convolution of the image with the filter
-       float sumX = 0;
-       int dy;
-       for(dy = -FILTER_RADIUS; dy <= FILTER_RADIUS; dy++) {
-    	   int dx;
-          for(dx = -FILTER_RADIUS; dx <= FILTER_RADIUS; dx++) {
-             float Pixel = (float)(laplaceimage[i*width*2 + j +  (dy * width*2 + dx)]);
-             sumX += Pixel * laplacianMatrix[(dy + FILTER_RADIUS) * FILTER_DIAMETER + (dx+FILTER_RADIUS)];
-          }
-	}
-       imageOut[i*width*2 + j] = CLAMP_8bit(sumX/64);
-    }
-  }
-  free(laplaceimage);
 }
 
-
 #endif // _PYRAMID_KERNEL_H_
 
 
@@ -41,6 +41,13 @@
 #include <cuda_runtime.h>
 #include "ppm.h"
 #include "options.h"
+#include "edgemask.h"
+#include "canny.h"
+#include "dirtytiles.h"
+#include "gradient.h"
+#include "histogram.h"
+#include "stencil.h"
+#include "workers.h"
 
 // Project Specific Defines
 #define BLOCK_SIZE 	8
@@ -59,12 +66,21 @@
 //#define DEBUG
 
 #define TIMING_FILE	"sobel_timing.txt"
+#define MASK_FILE	"sobel_mask.pbm"
+#define ORIENT_FILE	"sobel_orient.pgm"
+#define EDGE_THRESHOLD	128	// same as THRESHOLD in sobel_kernel.cu
 #define NS_PER_SEC	1000000000
 #define MS_PER_SEC	1000000
 
-// Kernels (in sobel_kernel.cu)
+// Kernels (in sobel_kernel.cu and sobel_cpu.cpp)
 extern void sobel_transform_wrapper(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height, dim3 grid, dim3 threads);
 extern void CPU_transform(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height);
+extern void CPU_transform_rows(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height, unsigned int y0, unsigned int y1, stencil_op_t op);
+extern void CPU_transform_parallel(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height, stencil_op_t op, unsigned int *hists);
+extern void CPU_transform_mask(edge_mask_t *mask, unsigned char *img_in, int threshold, stencil_op_t op);
+extern void CPU_transform_inplace(unsigned char *img, unsigned int width, unsigned int height, stencil_op_t op, unsigned char *row_bufs, unsigned int *hists);
+extern void CPU_transform_dirty(unsigned char *img_out, unsigned char *img_in, const dirty_tiles_t *tiles, stencil_op_t op);
+extern void CPU_sobel_separable(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height, int ksize, short *row_bufs, unsigned int *hists);
 
 // Global variables for RT threads
 pthread_attr_t rt_sched_attr;
@@ -79,6 +95,31 @@ struct timespec run_time = {0, 0};
 unsigned int img_width, img_height, img_chan;
 bool run_once = false;
 int freq = 0;
+int num_threads = 1;
+stencil_op_t stencil_op = STENCIL_SOBEL;
+int sobel_ksize = 3;
+short *ksize_rows = NULL;
+bool use_inplace = false;
+unsigned char *inplace_rows = NULL;
+bool auto_thresh = false;
+unsigned int *sub_hists = NULL;
+unsigned int edge_hist[HIST_BINS];
+bool use_mask = false;
+std::string maskFilename = MASK_FILE;
+int edge_threshold = EDGE_THRESHOLD;
+edge_mask_t edge_mask = {0, 0, 0, NULL};
+bool use_grad = false;
+grad_norm_t grad_norm = GRAD_L1;
+int orient_bins = 0;
+bool dump_orient = false;
+gradient_t grad;
+bool use_canny = false;
+int canny_low = EDGE_THRESHOLD/2;
+canny_t canny;
+bool use_incremental = false;
+int sad_threshold = 0;
+dirty_tiles_t tiles;
+unsigned int dirty_count = 0;
 std::string imageFilename = DEFAULT_IMAGE;
 double elap_time_d;
 
@@ -253,10 +294,72 @@ void *CPU_transform_thread(void * threadp)
 	// CPU transform local variables
 	struct timespec start_time, end_time, elap_time, diff_time;
 	int errVal;
-	double start_time_d, end_time_d, diff_time_d;
+	double start_time_d, end_time_d, diff_time_d, transform_time_d;
 
-	// Allocate memory
-	h_img_out_array = (unsigned char *)malloc(img_width * img_height);
+	// Allocate memory, in place mode has no output image (R010)
+	if(!use_inplace)
+		h_img_out_array = (unsigned char *)malloc(img_width * img_height);
+	if(use_mask && !edge_mask_alloc(&edge_mask, img_width, img_height))
+	{
+		printf("Could not allocate the edge mask, writing the byte image instead.\n");
+		use_mask = false;
+	}
+	if(use_grad && !gradient_alloc(&grad, img_width, img_height, grad_norm, orient_bins))
+	{
+		printf("Could not allocate the gradient buffers, using the plain Sobel transform.\n");
+		use_grad = false;
+		use_canny = false;
+	}
+	if(use_canny && !canny_alloc(&canny, img_width, img_height))
+	{
+		printf("Could not allocate the Canny buffers, thresholding the gradient instead.\n");
+		use_canny = false;
+	}
+	
+	// Worker threads are created once and reused for every frame
+	if(num_threads > 1 && !workers_start(num_threads))
+		printf("Could not start worker threads, using a single thread.\n");
+	
+	// One row buffer per worker for the separable 5x5 / 7x7 Sobel
+	if(sobel_ksize > 3)
+	{
+		ksize_rows = (short *)malloc(sizeof(short) * img_width * workers_count());
+		if(ksize_rows == NULL)
+		{
+			printf("Could not allocate the row buffers, using ksize 3.\n");
+			sobel_ksize = 3;
+		}
+	}
+	
+	// Three rolling rows per worker replace the output image in place mode
+	if(use_inplace)
+	{
+		inplace_rows = (unsigned char *)malloc(3 * img_width * workers_count());
+		if(inplace_rows == NULL)
+		{
+			printf("Could not allocate the row buffers, using a separate output image.\n");
+			use_inplace = false;
+			h_img_out_array = (unsigned char *)malloc(img_width * img_height);
+		}
+	}
+	
+	// Reference frame and tile flags for the incremental transform
+	if(use_incremental && !dirty_tiles_alloc(&tiles, img_width, img_height, sad_threshold))
+	{
+		printf("Could not allocate the reference frame, transforming every tile.\n");
+		use_incremental = false;
+	}
+	
+	// One sub-histogram per worker for the Otsu threshold
+	if(auto_thresh)
+	{
+		sub_hists = (unsigned int *)malloc(sizeof(unsigned int) * HIST_SIZE * workers_count());
+		if(sub_hists == NULL)
+		{
+			printf("Could not allocate the histograms, using threshold %d.\n", edge_threshold);
+			auto_thresh = false;
+		}
+	}
 	
 	// Infinite loop to allow for power measurement
 	do
@@ -269,7 +372,48 @@ void *CPU_transform_thread(void * threadp)
 		}
 		start_time_d = timespec2double(start_time);
         
-		CPU_transform(h_img_out_array, h_img_in_array, img_width, img_height);
+		if(auto_thresh)
+			memset(sub_hists, 0, sizeof(unsigned int) * HIST_SIZE * workers_count());
+		
+		if(use_incremental)
+		{
+			dirty_count = CPU_dirty_tiles_update(&tiles, h_img_in_array);
+			CPU_transform_dirty(h_img_out_array, h_img_in_array, &tiles, stencil_op);
+		}
+		else if(use_inplace)
+			CPU_transform_inplace(h_img_in_array, img_width, img_height, stencil_op, inplace_rows, sub_hists);
+		else if(use_grad)
+		{
+			CPU_gradient(&grad, h_img_in_array);
+			if(use_canny)
+				CPU_canny(&canny, &grad, gradient_threshold(grad_norm, canny_low), gradient_threshold(grad_norm, edge_threshold), &edge_mask);
+		}
+		else if(sobel_ksize > 3)
+		{
+			CPU_sobel_separable(h_img_out_array, h_img_in_array, img_width, img_height, sobel_ksize, ksize_rows, sub_hists);
+			if(use_mask && !auto_thresh)
+				edge_mask_from_image(&edge_mask, h_img_out_array, edge_threshold-1);
+		}
+		else if(use_mask && !auto_thresh)
+			CPU_transform_mask(&edge_mask, h_img_in_array, edge_threshold, stencil_op);
+		else if(workers_count() > 1 || auto_thresh)
+			CPU_transform_parallel(h_img_out_array, h_img_in_array, img_width, img_height, stencil_op, sub_hists);
+		else if(stencil_op != STENCIL_SOBEL)
+			CPU_transform_rows(h_img_out_array, h_img_in_array, img_width, img_height, 0, img_height, stencil_op);
+		else
+			CPU_transform(h_img_out_array, h_img_in_array, img_width, img_height);
+		
+		// Otsu threshold from this frame's histogram, then threshold the frame with it
+		if(auto_thresh)
+		{
+			unsigned char *img = use_inplace ? h_img_in_array : h_img_out_array;
+			histogram_merge(edge_hist, sub_hists, workers_count());
+			edge_threshold = histogram_otsu(edge_hist);
+			if(use_mask)
+				edge_mask_from_image(&edge_mask, img, edge_threshold-1);
+			else
+				histogram_binarize(img, (unsigned long)img_width*img_height, edge_threshold);
+		}
 		
 		// Get end of transform time timing
 		if(clock_gettime(CLOCK_REALTIME, &end_time) )
@@ -277,6 +421,7 @@ void *CPU_transform_thread(void * threadp)
 			printf("clock_gettime() - end - error.. exiting.\n");
 			break;
 		}
+		transform_time_d = timespec2double(end_time) - start_time_d;
 		
 		if(run_time.tv_nsec != 0)
 		{
@@ -314,8 +459,21 @@ void *CPU_transform_thread(void * threadp)
 		}
 		end_time_d = timespec2double(end_time);
 		elap_time_d = end_time_d - start_time_d;
-		printf("     Freq: %f Hz\n", 1000.0/elap_time_d);
+		printf("     Freq: %f Hz (%.0f px/s at ksize %d on %d thread(s))\n", 1000.0/elap_time_d,
+			(double)img_width*img_height*1000.0/transform_time_d, sobel_ksize, workers_count());
+		if(auto_thresh)
+			printf("     Otsu threshold: %d\n", edge_threshold);
+		if(use_incremental)
+			printf("     Tiles recomputed: %u of %u (%.1f%%)\n", dirty_count, tiles.tiles_x*tiles.tiles_y,
+				100.0*dirty_count/(tiles.tiles_x*tiles.tiles_y));
 	} while(!run_once);
+	
+	workers_stop();
+	free(ksize_rows);
+	free(inplace_rows);
+	free(sub_hists);
+	if(use_incremental)
+		dirty_tiles_free(&tiles);
 	return NULL;
 }
 
@@ -336,7 +494,7 @@ int main(int argc, char* argv[])
 	// Check input
 	if(options.has("help") || options.has("h") || options.has("?")) 
 	{
-		std::cout << "Usage: " << argv[0] << " [-continuous [-fps=FPS]] [-img=imageFilename]  [-cuda]" << std::endl;
+		std::cout << "Usage: " << argv[0] << " [-continuous [-fps=FPS]] [-img=imageFilename]  [-cuda] [-threads=N] [-op=sobel|scharr|prewitt|laplace] [-ksize=3|5|7] [-inplace] [-incremental [-sad-threshold=N]] [-mask[=pbm|pgm] [-threshold=T]] [-autothresh] [-grad=l1|l2|sq [-orient-bins=8|16]] [-canny [-threshold=T] [-canny-low=T]]" << std::endl;
 		exit(EXIT_SUCCESS);
 	}
 	
@@ -383,12 +541,169 @@ int main(int argc, char* argv[])
 		std::cout << "Program will not wait for acknowledgement" << std::endl;
 	}
 	
+	if(options.has("threads"))
+	{
+		if(use_cuda)
+			std::cout << "Worker threads only run the CPU transform, ignoring -threads" << std::endl;
+		else
+		{
+			num_threads = options.get<int>("threads");
+			if(num_threads < 1)
+				num_threads = 1;
+			std::cout << "CPU transform will use " << num_threads << " thread(s)" << std::endl;
+		}
+	}
+	
+	if(options.has("op"))
+	{
+		if(use_cuda)
+			std::cout << "The CUDA transform is Sobel only, ignoring -op" << std::endl;
+		else
+		{
+			if(!stencil_parse_op(options.get<std::string>("op").c_str(), &stencil_op))
+			{
+				std::cout << "Unknown operator '" << options.get<std::string>("op") << "', using sobel" << std::endl;
+				stencil_op = STENCIL_SOBEL;
+			}
+			else
+				std::cout << "CPU transform will use the " << options.get<std::string>("op") << " operator" << std::endl;
+		}
+	}
+	
+	if(options.has("ksize"))
+	{
+		if(use_cuda)
+			std::cout << "The CUDA transform is 3x3 only, ignoring -ksize" << std::endl;
+		else
+		{
+			sobel_ksize = options.get<int>("ksize");
+			if(sobel_ksize != 3 && sobel_ksize != 5 && sobel_ksize != 7)
+			{
+				std::cout << "Unsupported ksize " << sobel_ksize << ", using 3" << std::endl;
+				sobel_ksize = 3;
+			}
+			else if(sobel_ksize > 3 && stencil_op != STENCIL_SOBEL)
+			{
+				std::cout << "Only the sobel operator has a " << sobel_ksize << "x" << sobel_ksize << " aperture, using 3" << std::endl;
+				sobel_ksize = 3;
+			}
+			else
+				std::cout << "CPU transform will use a " << sobel_ksize << "x" << sobel_ksize << " Sobel aperture" << std::endl;
+		}
+	}
+	
+	if(options.has("mask"))
+	{
+		if(use_cuda)
+			std::cout << "Edge masks only come from the CPU transform, ignoring -mask" << std::endl;
+		else
+		{
+			use_mask = true;
+			if(options.get<std::string>("mask") == "pgm")
+				maskFilename = "sobel_mask.pgm";
+			if(options.has("threshold"))
+			{
+				edge_threshold = options.get<int>("threshold");
+				edge_threshold = (edge_threshold < 1) ? 1 : (edge_threshold > 255) ? 255 : edge_threshold;
+			}
+			std::cout << "CPU transform will write a thresholded edge mask (threshold " << edge_threshold << ") to " << maskFilename << std::endl;
+		}
+	}
+	
+	if(options.has("grad") || options.has("orient-bins"))
+	{
+		if(use_cuda)
+			std::cout << "The gradient only runs on the CPU, ignoring -grad and -orient-bins" << std::endl;
+		else
+		{
+			use_grad = true;
+			if(options.has("grad") && !gradient_parse_norm(options.get<std::string>("grad").c_str(), &grad_norm))
+			{
+				std::cout << "Unknown gradient norm '" << options.get<std::string>("grad") << "', using l1" << std::endl;
+				grad_norm = GRAD_L1;
+			}
+			if(options.has("orient-bins"))
+				orient_bins = options.get<int>("orient-bins");
+			std::cout << "CPU transform will compute the gradient magnitude";
+			if(orient_bins > 0)
+				std::cout << " and a " << orient_bins << " bin orientation map";
+			std::cout << std::endl;
+			dump_orient = (orient_bins > 0);
+			if(sobel_ksize > 3)
+			{
+				std::cout << "The gradient uses the 3x3 aperture, ignoring -ksize" << std::endl;
+				sobel_ksize = 3;
+			}
+		}
+	}
+	
+	if(options.has("canny"))
+	{
+		if(use_cuda)
+			std::cout << "Canny only runs on the CPU, ignoring -canny" << std::endl;
+		else
+		{
+			use_canny = true;
+			use_grad = true;
+			use_mask = true;
+			if(dump_orient && orient_bins != CANNY_ORIENT_BINS)
+				std::cout << "Canny quantizes the orientation to " << CANNY_ORIENT_BINS << " bins, using " << CANNY_ORIENT_BINS << std::endl;
+			orient_bins = CANNY_ORIENT_BINS;
+			sobel_ksize = 3;
+			if(options.has("threshold"))
+			{
+				edge_threshold = options.get<int>("threshold");
+				edge_threshold = (edge_threshold < 1) ? 1 : (edge_threshold > 255) ? 255 : edge_threshold;
+			}
+			canny_low = options.has("canny-low") ? options.get<int>("canny-low") : edge_threshold/2;
+			canny_low = (canny_low < 1) ? 1 : (canny_low > edge_threshold) ? edge_threshold : canny_low;
+			std::cout << "CPU transform will thin the edges with Canny (low " << canny_low << ", high " << edge_threshold << ") into " << maskFilename << std::endl;
+		}
+	}
+	
+	if(options.has("autothresh"))
+	{
+		if(use_cuda || use_grad)
+			std::cout << "Automatic thresholding only applies to the CPU image transform, ignoring -autothresh" << std::endl;
+		else
+		{
+			auto_thresh = true;
+			std::cout << "CPU transform will pick an Otsu threshold every frame" << std::endl;
+		}
+	}
+	
+	if(options.has("inplace"))
+	{
+		if(use_cuda || use_mask || use_grad || sobel_ksize > 3)
+			std::cout << "In place mode only applies to the 3x3 CPU image transform, ignoring -inplace" << std::endl;
+		else
+		{
+			use_inplace = true;
+			std::cout << "CPU transform will overwrite the input image, keeping 3 rows per thread" << std::endl;
+			if(!run_once)
+				std::cout << "Each frame transforms the result of the previous one" << std::endl;
+		}
+	}
+	
+	if(options.has("incremental"))
+	{
+		if(use_cuda || use_mask || use_grad || use_inplace || auto_thresh || sobel_ksize > 3)
+			std::cout << "Incremental mode only applies to the 3x3 CPU image transform, ignoring -incremental" << std::endl;
+		else
+		{
+			use_incremental = true;
+			if(options.has("sad-threshold"))
+				sad_threshold = (options.get<int>("sad-threshold") < 0) ? 0 : options.get<int>("sad-threshold");
+			std::cout << "CPU transform will only recompute " << DIRTY_TILE << "x" << DIRTY_TILE << " tiles whose SAD is above " << sad_threshold << std::endl;
+		}
+	}
+	
 #ifdef DEBUG
 	printf("DEBUG: Begin Program. \n");
 #endif
 	
-	// Initialize CUDA
-	if(!InitCUDA()) {
+	// Initialize CUDA, the CPU transform runs on nodes without a GPU
+	if(use_cuda && !InitCUDA()) {
 		exit(EXIT_CUDA_ERR);
 	};
 	
@@ -408,7 +723,7 @@ int main(int argc, char* argv[])
 		exit(EXIT_IMG_SZ);
 	}
 	
-	h_img_in_array = (unsigned char *)malloc(sizeof(unsigned int) * img_width * img_height);
+	h_img_in_array = (unsigned char *)malloc(sizeof(unsigned char) * img_width * img_height * img_chan);
 	readppm(h_img_in_array, &tempInt, 
 	tempChar, &tempInt,
 	&img_height, &img_width, &img_chan,
@@ -473,7 +788,38 @@ int main(int argc, char* argv[])
 	pthread_join(rt_thread, NULL);
 	
 	// Write back result
-	dump_ppm_data("sobel_out.pgm", img_width, img_height, img_chan, h_img_out_array);
+	if(use_cuda)
+		dump_ppm_data("sobel_out.pgm", img_width, img_height, img_chan, h_img_out_array);
+	else
+	{
+		if(use_canny)
+		{
+			// Edge pixels the thick Sobel response would have given at the high threshold
+			unsigned int high = gradient_threshold(grad_norm, edge_threshold);
+			unsigned long thick = 0;
+			for(unsigned long i=0; i<(unsigned long)img_width*img_height; i++)
+				thick += (grad.mag[i] >= high);
+			printf("Sobel edge pixels: %lu\n", thick);
+		}
+		else if(use_grad && use_mask)
+			gradient_to_mask(&grad, &edge_mask, gradient_threshold(grad_norm, edge_threshold));
+		else if(use_grad)
+			gradient_to_image(&grad, h_img_out_array);
+		
+		if(use_mask)
+		{
+			printf("Edge pixels: %lu\n", edge_mask_count(&edge_mask));
+			edge_mask_dump(&edge_mask, maskFilename);
+		}
+		else
+			dump_ppm_data("sobel_out.pgm", img_width, img_height, img_chan, use_inplace ? h_img_in_array : h_img_out_array);
+		
+		if(use_grad && grad.orient && dump_orient)
+		{
+			gradient_orient_to_image(&grad, h_img_out_array);
+			dump_ppm_data(ORIENT_FILE, img_width, img_height, img_chan, h_img_out_array);
+		}
+	}
 	
 	// Free up memory
 #ifdef DEBUG
@@ -481,6 +827,11 @@ int main(int argc, char* argv[])
 #endif
 	free(h_img_out_array);
 	free(h_img_in_array);
+	edge_mask_free(&edge_mask);
+	if(use_grad)
+		gradient_free(&grad);
+	if(use_canny)
+		canny_free(&canny);
 
 	// Final cleanup and whatnot
 	if( run_once && !wait ) // usually only in testing, so output speed of transform to file
@@ -0,0 +1,682 @@
+//*****************************************************************************************//
+//  sobel_cpu.cpp - CPU Sobel Edge detection benchmark kernels
+//
+//  Authors: Ramnarayan Krishnamurthy, University of Colorado (Shreyas.Ramnarayan@gmail.com)
+//	         Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//			 
+//	This code was used to obtain results documented in the SPIE Sensor and Technologies paper: 
+//	S. Siewert, V. Angoth, R. Krishnamurthy, K. Mani, K. Mock, S. B. Singh, S. Srivistava, 
+//	C. Wagner, R. Claus, M. Demi Vis, “Software Defined Multi-Spectral Imaging for Arctic 
+//	Sensor Networks”, SPIE Algorithms and Technologies for Multipectral, Hyperspectral, and 
+//	Ultraspectral Imagery XXII, Baltimore, Maryland, April 2016. 
+//
+//	This code was developed for, tested and run on a Jetson TK1 development kit by NVIDIA
+//  running Ubuntu 14.04 
+//	
+//	Please use at your own risk. We are sharing so that other researchers and developers can 
+//	recreate our results and make suggestions to improve and extend the benchmarks over time.
+//
+//	The CPU kernels live here rather than in sobel_kernel.cu so that the SIMD intrinsics
+//	headers only ever go through the host compiler.
+//
+//*****************************************************************************************//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dirtytiles.h"
+#include "edgemask.h"
+#include "histogram.h"
+#include "stencil.h"
+#include "stencil_simd.h"
+#include "workers.h"
+
+#define MAXRGB	 	255
+
+//***************************************************************//
+// Op applied to a single pixel using the CPU. Missing neighbours
+// (image border, or a NULL above/below row) are treated as zero.
+//***************************************************************//
+template<class Op>
+static inline unsigned char stencil_pixel(const unsigned char *above, const unsigned char *mid, const unsigned char *below, int x, int width)
+{
+	bool l = (x-1 >= 0), r = (x+1 < width);
+	int pixel;
+	
+	pixel = stencil_apply<Op>((l && above)? above[x-1]:0, above? above[x]:0, (r && above)? above[x+1]:0,
+	                          l? mid[x-1]:0,              mid[x],            r? mid[x+1]:0,
+	                          (l && below)? below[x-1]:0, below? below[x]:0, (r && below)? below[x+1]:0);
+	pixel=(pixel<0)?0:pixel;
+	pixel=(pixel>MAXRGB)?MAXRGB:pixel;
+	return pixel;
+}
+
+#if defined(__AVX2__)
+//***************************************************************//
+// Op applied to pixels x..x+31, needs 1 <= x and x+32 < width
+//***************************************************************//
+template<class Op>
+static inline __m256i stencil_32(const unsigned char *above, const unsigned char *mid, const unsigned char *below, int x)
+{
+	__m256i lo, hi;
+	
+	stencil_sums_32<Op>(lo, hi, above, mid, below, x);
+	
+	// Unpack and pack both work per 128 bit lane so the order comes back out right
+	return _mm256_packus_epi16(lo, hi);
+}
+#endif
+
+#if defined(__SSE2__)
+//***************************************************************//
+// Op applied to pixels x..x+15, needs 1 <= x and x+16 < width
+//***************************************************************//
+template<class Op>
+static inline __m128i stencil_16(const unsigned char *above, const unsigned char *mid, const unsigned char *below, int x)
+{
+	__m128i lo, hi;
+	
+	stencil_sums_16<Op>(lo, hi, above, mid, below, x);
+	return _mm_packus_epi16(lo, hi);
+}
+#endif
+
+//***************************************************************//
+// Op applied to pixels [x0, x1) of one row using the CPU. The one
+// pixel border goes through stencil_pixel, the interior is branch
+// free and handles 32 (AVX2) or 16 (SSE2) pixels per iteration.
+// Saturating packs do the same 0..MAXRGB clamp as the scalar
+// version so the output is bit for bit identical.
+//***************************************************************//
+template<class Op>
+static void stencil_span(unsigned char *row_out, const unsigned char *above, const unsigned char *mid, const unsigned char *below, int width, int x0, int x1)
+{
+	int x = x0;
+	
+	if(x0 >= x1)
+		return;
+	
+	// Top and bottom rows are rare, keep them on the scalar path
+	if(!above || !below || width < 3)
+	{
+		for(; x<x1; x++)
+			row_out[x] = stencil_pixel<Op>(above, mid, below, x, width);
+		return;
+	}
+	
+	if(x == 0)
+	{
+		row_out[0] = stencil_pixel<Op>(above, mid, below, 0, width);
+		x = 1;
+	}
+	
+	int end = (x1 < width-1) ? x1 : width-1;
+#if defined(__AVX2__)
+	for(; x+32<=end; x+=32)
+		_mm256_storeu_si256((__m256i *)(row_out+x), stencil_32<Op>(above, mid, below, x));
+#endif
+#if defined(__SSE2__)
+	for(; x+16<=end; x+=16)
+		_mm_storeu_si128((__m128i *)(row_out+x), stencil_16<Op>(above, mid, below, x));
+#endif
+	// Interior remainder, no bounds checks needed here
+	for(; x<end; x++)
+	{
+		int pixel = stencil_apply<Op>(above[x-1], above[x], above[x+1],
+		                              mid[x-1],   mid[x],   mid[x+1],
+		                              below[x-1], below[x], below[x+1]);
+		pixel=(pixel<0)?0:pixel;
+		pixel=(pixel>MAXRGB)?MAXRGB:pixel;
+		row_out[x] = pixel;
+	}
+	
+	if(x1 == width)
+		row_out[width-1] = stencil_pixel<Op>(above, mid, below, width-1, width);
+}
+
+template<class Op>
+static void stencil_row(unsigned char *row_out, const unsigned char *above, const unsigned char *mid, const unsigned char *below, int width)
+{
+	stencil_span<Op>(row_out, above, mid, below, width, 0, width);
+}
+
+//***************************************************************//
+// Thresholded Op straight into a packed edge mask row. Bit x is set
+// when the clamped response is at or above threshold, which is the
+// same test sobel_transform makes with THRESHOLD. Each 64 bit word
+// is filled from SIMD groups when they are fully inside the image
+// and bit by bit otherwise.
+//***************************************************************//
+template<class Op>
+static void stencil_mask_row(uint64_t *row_bits, const unsigned char *above, const unsigned char *mid, const unsigned char *below, int width, int threshold)
+{
+	int words = (width + 63) / 64;
+	bool interior = (above && below);
+#if defined(__AVX2__)
+	__m256i thresh32 = _mm256_set1_epi8((char)threshold);
+#endif
+#if defined(__SSE2__)
+	__m128i thresh16 = _mm_set1_epi8((char)threshold);
+#endif
+	
+	for(int k=0; k<words; k++)
+	{
+		uint64_t word = 0;
+		int x0 = k*64;
+		int g = 0;
+		
+		if(interior)
+		{
+#if defined(__AVX2__)
+			for(; g<64 && x0+g>=1 && x0+g+32<=width-1; g+=32)
+			{
+				__m256i v = stencil_32<Op>(above, mid, below, x0+g);
+				__m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(v, thresh32), v);
+				word |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ge) << g;
+			}
+#endif
+#if defined(__SSE2__)
+			for(; g<64 && x0+g>=1 && x0+g+16<=width-1; g+=16)
+			{
+				__m128i v = stencil_16<Op>(above, mid, below, x0+g);
+				__m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, thresh16), v);
+				word |= (uint64_t)(uint16_t)_mm_movemask_epi8(ge) << g;
+			}
+#endif
+		}
+		for(; g<64 && x0+g<width; g++)
+		{
+			if(stencil_pixel<Op>(above, mid, below, x0+g, width) >= threshold)
+				word |= (uint64_t)1 << g;
+		}
+		row_bits[k] = word;
+	}
+}
+
+//***************************************************************//
+// Pick the instantiation for an operator chosen at run time
+//***************************************************************//
+typedef void (*stencil_row_fn)(unsigned char *, const unsigned char *, const unsigned char *, const unsigned char *, int);
+typedef void (*stencil_span_fn)(unsigned char *, const unsigned char *, const unsigned char *, const unsigned char *, int, int, int);
+typedef void (*stencil_mask_row_fn)(uint64_t *, const unsigned char *, const unsigned char *, const unsigned char *, int, int);
+
+static stencil_row_fn stencil_row_for(stencil_op_t op)
+{
+	switch(op)
+	{
+	case STENCIL_SCHARR:	return stencil_row<scharr_x_op>;
+	case STENCIL_PREWITT:	return stencil_row<prewitt_x_op>;
+	case STENCIL_LAPLACE:	return stencil_row<laplace_op>;
+	default:				return stencil_row<sobel_x_op>;
+	}
+}
+
+static stencil_span_fn stencil_span_for(stencil_op_t op)
+{
+	switch(op)
+	{
+	case STENCIL_SCHARR:	return stencil_span<scharr_x_op>;
+	case STENCIL_PREWITT:	return stencil_span<prewitt_x_op>;
+	case STENCIL_LAPLACE:	return stencil_span<laplace_op>;
+	default:				return stencil_span<sobel_x_op>;
+	}
+}
+
+static stencil_mask_row_fn stencil_mask_row_for(stencil_op_t op)
+{
+	switch(op)
+	{
+	case STENCIL_SCHARR:	return stencil_mask_row<scharr_x_op>;
+	case STENCIL_PREWITT:	return stencil_mask_row<prewitt_x_op>;
+	case STENCIL_LAPLACE:	return stencil_mask_row<laplace_op>;
+	default:				return stencil_mask_row<sobel_x_op>;
+	}
+}
+
+//***************************************************************//
+// Op applied to rows [y0, y1) using the CPU. Rows y0-1 and y1 are
+// only read, which gives each band its one row halo.
+//***************************************************************//
+void CPU_transform_rows(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height, unsigned int y0, unsigned int y1, stencil_op_t op)
+{
+	stencil_row_fn row = stencil_row_for(op);
+	
+	for(int y=y0; y<(int)y1; y++)
+	{
+		#ifdef DEBUG
+			printf("Row Y:%d\n",y);
+		#endif
+		const unsigned char *above = (y > 0) ? &img_in[(y-1)*width] : NULL;
+		const unsigned char *below = (y+1 < (int)height) ? &img_in[(y+1)*width] : NULL;
+		row(&img_out[y*width], above, &img_in[y*width], below, width);
+	}
+}
+
+//***************************************************************//
+// Sobel transform using the CPU
+//***************************************************************//
+void CPU_transform(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height) 
+{
+	CPU_transform_rows(img_out, img_in, width, height, 0, height, STENCIL_SOBEL);
+}
+
+//***************************************************************//
+// Band parallel transform on the persistent worker threads. If
+// hists is not NULL it holds workers_count() sub-histograms of
+// HIST_SIZE entries; each band counts its rows into its own while
+// they are still in cache.
+//***************************************************************//
+struct sobel_band_args
+{
+	unsigned char *img_out;
+	unsigned char *img_in;
+	unsigned int width;
+	unsigned int height;
+	stencil_op_t op;
+	unsigned int *hists;
+};
+
+static void CPU_transform_band(void *arg, int index, int count)
+{
+	struct sobel_band_args *band = (struct sobel_band_args *)arg;
+	unsigned int y0 = (unsigned int)((unsigned long)band->height * index / count);
+	unsigned int y1 = (unsigned int)((unsigned long)band->height * (index+1) / count);
+	
+	if(band->hists == NULL)
+	{
+		CPU_transform_rows(band->img_out, band->img_in, band->width, band->height, y0, y1, band->op);
+		return;
+	}
+	for(unsigned int y=y0; y<y1; y++)
+	{
+		CPU_transform_rows(band->img_out, band->img_in, band->width, band->height, y, y+1, band->op);
+		histogram_row(&band->hists[(unsigned long)index * HIST_SIZE], &band->img_out[(unsigned long)y*band->width], band->width);
+	}
+}
+
+void CPU_transform_parallel(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height, stencil_op_t op, unsigned int *hists)
+{
+	struct sobel_band_args band = { img_out, img_in, width, height, op, hists };
+	workers_run(CPU_transform_band, &band);
+}
+
+//***************************************************************//
+// Incremental transform for continuous mode: output pixels whose
+// 3x3 neighbourhood touches a dirty tile are recomputed, the rest
+// keep the previous frame's value. That is every pixel of a dirty
+// tile plus the one pixel strips of clean tiles next to one. Each
+// band owns whole tile rows of the output, so no pixel has two
+// writers.
+//***************************************************************//
+struct sobel_dirty_args
+{
+	unsigned char *img_out;
+	unsigned char *img_in;
+	const dirty_tiles_t *tiles;
+	stencil_op_t op;
+};
+
+static inline void dirty_span(stencil_span_fn span, unsigned char *img_out, const unsigned char *img_in, int width, int height, int y, int x0, int x1)
+{
+	const unsigned char *above = (y > 0) ? &img_in[(unsigned long)(y-1)*width] : NULL;
+	const unsigned char *below = (y+1 < height) ? &img_in[(unsigned long)(y+1)*width] : NULL;
+	span(&img_out[(unsigned long)y*width], above, &img_in[(unsigned long)y*width], below, width, x0, x1);
+}
+
+static void CPU_transform_dirty_band(void *arg, int index, int count)
+{
+	struct sobel_dirty_args *job = (struct sobel_dirty_args *)arg;
+	const dirty_tiles_t *tiles = job->tiles;
+	stencil_span_fn span = stencil_span_for(job->op);
+	int width = tiles->width;
+	int height = tiles->height;
+	int ty0 = (int)((unsigned long)tiles->tiles_y * index / count);
+	int ty1 = (int)((unsigned long)tiles->tiles_y * (index+1) / count);
+	
+	for(int ty=ty0; ty<ty1; ty++)
+	{
+		int y0 = ty * DIRTY_TILE;
+		int y1 = (y0 + DIRTY_TILE < height) ? y0 + DIRTY_TILE : height;
+		
+		for(int tx=0; tx<(int)tiles->tiles_x; tx++)
+		{
+			int x0 = tx * DIRTY_TILE;
+			int x1 = (x0 + DIRTY_TILE < width) ? x0 + DIRTY_TILE : width;
+			
+			if(dirty_tile(tiles, tx, ty))
+			{
+				for(int y=y0; y<y1; y++)
+					dirty_span(span, job->img_out, job->img_in, width, height, y, x0, x1);
+				continue;
+			}
+			
+			// Clean tile: only the edge pixels next to a dirty neighbour
+			if(dirty_tile(tiles, tx, ty-1))
+				dirty_span(span, job->img_out, job->img_in, width, height, y0, x0, x1);
+			if(dirty_tile(tiles, tx, ty+1))
+				dirty_span(span, job->img_out, job->img_in, width, height, y1-1, x0, x1);
+			if(dirty_tile(tiles, tx-1, ty))
+				for(int y=y0; y<y1; y++)
+					dirty_span(span, job->img_out, job->img_in, width, height, y, x0, x0+1);
+			if(dirty_tile(tiles, tx+1, ty))
+				for(int y=y0; y<y1; y++)
+					dirty_span(span, job->img_out, job->img_in, width, height, y, x1-1, x1);
+			if(dirty_tile(tiles, tx-1, ty-1))
+				dirty_span(span, job->img_out, job->img_in, width, height, y0, x0, x0+1);
+			if(dirty_tile(tiles, tx+1, ty-1))
+				dirty_span(span, job->img_out, job->img_in, width, height, y0, x1-1, x1);
+			if(dirty_tile(tiles, tx-1, ty+1))
+				dirty_span(span, job->img_out, job->img_in, width, height, y1-1, x0, x0+1);
+			if(dirty_tile(tiles, tx+1, ty+1))
+				dirty_span(span, job->img_out, job->img_in, width, height, y1-1, x1-1, x1);
+		}
+	}
+}
+
+void CPU_transform_dirty(unsigned char *img_out, unsigned char *img_in, const dirty_tiles_t *tiles, stencil_op_t op)
+{
+	struct sobel_dirty_args job = { img_out, img_in, tiles, op };
+	workers_run(CPU_transform_dirty_band, &job);
+}
+
+//***************************************************************//
+// In place transform for R010: the result overwrites the input and
+// each band keeps only three rows of the original image. Before any
+// band writes, it copies the halo rows it shares with its neighbours
+// (y0-1 and y1); while it runs, two of the rows roll between the row
+// above and the row being overwritten.
+//***************************************************************//
+struct sobel_inplace_args
+{
+	unsigned char *img;
+	unsigned int width;
+	unsigned int height;
+	stencil_op_t op;
+	unsigned char *row_bufs;	// 3 rows of width bytes per worker
+	unsigned int *hists;		// optional, HIST_SIZE entries per worker
+};
+
+static void CPU_transform_inplace_halo(void *arg, int index, int count)
+{
+	struct sobel_inplace_args *band = (struct sobel_inplace_args *)arg;
+	unsigned int width = band->width;
+	unsigned int y0 = (unsigned int)((unsigned long)band->height * index / count);
+	unsigned int y1 = (unsigned int)((unsigned long)band->height * (index+1) / count);
+	unsigned char *rows = &band->row_bufs[(unsigned long)index * 3 * width];
+	
+	if(y0 > 0)
+		memcpy(&rows[0], &band->img[(unsigned long)(y0-1)*width], width);
+	if(y1 < band->height)
+		memcpy(&rows[2*width], &band->img[(unsigned long)y1*width], width);
+}
+
+static void CPU_transform_inplace_band(void *arg, int index, int count)
+{
+	struct sobel_inplace_args *band = (struct sobel_inplace_args *)arg;
+	stencil_row_fn row = stencil_row_for(band->op);
+	unsigned int width = band->width;
+	unsigned int height = band->height;
+	unsigned int y0 = (unsigned int)((unsigned long)height * index / count);
+	unsigned int y1 = (unsigned int)((unsigned long)height * (index+1) / count);
+	unsigned char *rows = &band->row_bufs[(unsigned long)index * 3 * width];
+	unsigned char *prev = &rows[0];
+	unsigned char *cur = &rows[width];
+	const unsigned char *last = &rows[2*width];
+	
+	for(unsigned int y=y0; y<y1; y++)
+	{
+		unsigned char *line = &band->img[(unsigned long)y*width];
+		const unsigned char *above = (y > 0) ? prev : NULL;
+		const unsigned char *below = (y+1 < height) ? ((y+1 < y1) ? line+width : last) : NULL;
+		unsigned char *tmp;
+		
+		memcpy(cur, line, width);
+		row(line, above, cur, below, width);
+		if(band->hists)
+			histogram_row(&band->hists[(unsigned long)index * HIST_SIZE], line, width);
+		
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+	}
+}
+
+void CPU_transform_inplace(unsigned char *img, unsigned int width, unsigned int height, stencil_op_t op, unsigned char *row_bufs, unsigned int *hists)
+{
+	struct sobel_inplace_args band = { img, width, height, op, row_bufs, hists };
+	
+	// Every halo has to be saved before the first band overwrites it
+	workers_run(CPU_transform_inplace_halo, &band);
+	workers_run(CPU_transform_inplace_band, &band);
+}
+
+//***************************************************************//
+// Thresholded transform of rows [y0, y1) into an edge mask
+//***************************************************************//
+void CPU_transform_mask_rows(edge_mask_t *mask, unsigned char *img_in, int threshold, unsigned int y0, unsigned int y1, stencil_op_t op)
+{
+	stencil_mask_row_fn row = stencil_mask_row_for(op);
+	unsigned int width = mask->width;
+	unsigned int height = mask->height;
+	
+	for(int y=y0; y<(int)y1; y++)
+	{
+		const unsigned char *above = (y > 0) ? &img_in[(y-1)*width] : NULL;
+		const unsigned char *below = (y+1 < (int)height) ? &img_in[(y+1)*width] : NULL;
+		row(edge_mask_row(mask, y), above, &img_in[y*width], below, width, threshold);
+	}
+}
+
+//***************************************************************//
+// Band parallel thresholded transform into an edge mask. Rows start
+// on a word boundary so the bands never share a word.
+//***************************************************************//
+struct sobel_mask_args
+{
+	edge_mask_t *mask;
+	unsigned char *img_in;
+	int threshold;
+	stencil_op_t op;
+};
+
+static void CPU_transform_mask_band(void *arg, int index, int count)
+{
+	struct sobel_mask_args *band = (struct sobel_mask_args *)arg;
+	unsigned int height = band->mask->height;
+	unsigned int y0 = (unsigned int)((unsigned long)height * index / count);
+	unsigned int y1 = (unsigned int)((unsigned long)height * (index+1) / count);
+	CPU_transform_mask_rows(band->mask, band->img_in, band->threshold, y0, y1, band->op);
+}
+
+void CPU_transform_mask(edge_mask_t *mask, unsigned char *img_in, int threshold, stencil_op_t op)
+{
+	struct sobel_mask_args band = { mask, img_in, threshold, op };
+	workers_run(CPU_transform_mask_band, &band);
+}
+
+//***************************************************************//
+// Separable Sobel x derivative for the 5x5 and 7x7 apertures. Each
+// kernel is a binomial smoothing column times an odd difference
+// row, so a pixel costs O(k) instead of O(k*k). The shift brings the
+// response back to the slope gain of the 3x3 kernel (16x and 256x
+// larger) so the same thresholds apply.
+//***************************************************************//
+static const short sobel5_smooth[5] = { 1, 4, 6, 4, 1 };
+static const short sobel5_diff[3]   = { 0, 2, 1 };	// d[r+j] = -d[r-j]
+static const short sobel7_smooth[7] = { 1, 6, 15, 20, 15, 6, 1 };
+static const short sobel7_diff[4]   = { 0, 5, 4, 1 };
+
+// Row pass for one pixel, taps outside the image are zero
+template<int K>
+static inline unsigned char sobel_separable_pixel(const short *col, int x, int width)
+{
+	const int r = K/2;
+	const short *diff = (K == 5) ? sobel5_diff : sobel7_diff;
+	const int shift = (K == 5) ? 4 : 8;
+	int sum = 0;
+	
+	for(int j=1; j<=r; j++)
+	{
+		int right = (x+j < width) ? col[x+j] : 0;
+		int left = (x-j >= 0) ? col[x-j] : 0;
+		sum += diff[j] * (right - left);
+	}
+	sum = (sum < 0) ? 0 : (sum >> shift);
+	return (sum > MAXRGB) ? MAXRGB : sum;
+}
+
+#if defined(__SSE2__)
+//***************************************************************//
+// Row pass for pixels x..x+7 as 32 bit sums, needs r <= x and
+// x+8+r <= width. Pairs of column differences go through madd so
+// the products never overflow 16 bits.
+//***************************************************************//
+template<int K>
+static inline __m128i sobel_separable_8(const short *col, int x)
+{
+	const int shift = (K == 5) ? 4 : 8;
+	__m128i d1 = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(col+x+1)), _mm_loadu_si128((const __m128i *)(col+x-1)));
+	__m128i d2 = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(col+x+2)), _mm_loadu_si128((const __m128i *)(col+x-2)));
+	__m128i w12 = (K == 5) ? _mm_set1_epi32((1 << 16) | 2) : _mm_set1_epi32((4 << 16) | 5);
+	__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(d1, d2), w12);
+	__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(d1, d2), w12);
+	
+	if(K == 7)
+	{
+		__m128i d3 = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(col+x+3)), _mm_loadu_si128((const __m128i *)(col+x-3)));
+		__m128i w3 = _mm_set1_epi32(1);
+		lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(d3, _mm_setzero_si128()), w3));
+		hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(d3, _mm_setzero_si128()), w3));
+	}
+	
+	// Arithmetic shift keeps negatives negative, packus then clamps them to 0
+	return _mm_packs_epi32(_mm_srai_epi32(lo, shift), _mm_srai_epi32(hi, shift));
+}
+#endif
+
+//***************************************************************//
+// One output row of the separable Sobel. col is a row buffer of
+// width shorts; the smoothed column sums are at most 64*255 so they
+// fit, and the buffer stays in L1 between the two passes.
+//***************************************************************//
+template<int K>
+static void sobel_separable_row(unsigned char *row_out, short *col, const unsigned char *img_in, int width, int height, int y)
+{
+	const int r = K/2;
+	const short *smooth = (K == 5) ? sobel5_smooth : sobel7_smooth;
+	int x = 0;
+	
+	// Column pass: smooth K input rows into the row buffer
+	if(y >= r && y+r < height)
+	{
+		const unsigned char *src[K];
+		for(int i=0; i<K; i++)
+			src[i] = &img_in[(unsigned long)(y+i-r)*width];
+#if defined(__SSE2__)
+		__m128i zero = _mm_setzero_si128();
+		for(; x+16<=width; x+=16)
+		{
+			__m128i lo = _mm_setzero_si128(), hi = _mm_setzero_si128();
+			for(int i=0; i<K; i++)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i *)(src[i]+x));
+				__m128i s = _mm_set1_epi16(smooth[i]);
+				lo = _mm_add_epi16(lo, _mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), s));
+				hi = _mm_add_epi16(hi, _mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), s));
+			}
+			_mm_storeu_si128((__m128i *)(col+x), lo);
+			_mm_storeu_si128((__m128i *)(col+x+8), hi);
+		}
+#endif
+		for(; x<width; x++)
+		{
+			int sum = 0;
+			for(int i=0; i<K; i++)
+				sum += smooth[i] * src[i][x];
+			col[x] = sum;
+		}
+	}
+	else
+	{
+		for(x=0; x<width; x++)
+		{
+			int sum = 0;
+			for(int i=0; i<K; i++)
+			{
+				int yy = y + i - r;
+				if(yy >= 0 && yy < height)
+					sum += smooth[i] * img_in[(unsigned long)yy*width + x];
+			}
+			col[x] = sum;
+		}
+	}
+	
+	// Row pass: odd difference across the buffer
+	for(x=0; x<r && x<width; x++)
+		row_out[x] = sobel_separable_pixel<K>(col, x, width);
+#if defined(__SSE2__)
+	for(; x+16+r<=width; x+=16)
+	{
+		__m128i lo = sobel_separable_8<K>(col, x);
+		__m128i hi = sobel_separable_8<K>(col, x+8);
+		_mm_storeu_si128((__m128i *)(row_out+x), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for(; x<width; x++)
+		row_out[x] = sobel_separable_pixel<K>(col, x, width);
+}
+
+//***************************************************************//
+// Separable Sobel of rows [y0, y1) with a ksize x ksize aperture
+// (5 or 7). col is a row buffer of width shorts.
+//***************************************************************//
+void CPU_sobel_separable_rows(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height, unsigned int y0, unsigned int y1, int ksize, short *col)
+{
+	for(int y=y0; y<(int)y1; y++)
+	{
+		if(ksize == 7)
+			sobel_separable_row<7>(&img_out[(unsigned long)y*width], col, img_in, width, height, y);
+		else
+			sobel_separable_row<5>(&img_out[(unsigned long)y*width], col, img_in, width, height, y);
+	}
+}
+
+//***************************************************************//
+// Band parallel separable Sobel. row_bufs holds workers_count()
+// row buffers of width shorts, one per band, allocated by the caller
+// so nothing is allocated per frame. hists is optional, as for
+// CPU_transform_parallel().
+//***************************************************************//
+struct sobel_separable_args
+{
+	unsigned char *img_out;
+	unsigned char *img_in;
+	unsigned int width;
+	unsigned int height;
+	int ksize;
+	short *row_bufs;
+	unsigned int *hists;
+};
+
+static void CPU_sobel_separable_band(void *arg, int index, int count)
+{
+	struct sobel_separable_args *band = (struct sobel_separable_args *)arg;
+	unsigned int y0 = (unsigned int)((unsigned long)band->height * index / count);
+	unsigned int y1 = (unsigned int)((unsigned long)band->height * (index+1) / count);
+	short *col = &band->row_bufs[(unsigned long)index * band->width];
+	
+	for(unsigned int y=y0; y<y1; y++)
+	{
+		CPU_sobel_separable_rows(band->img_out, band->img_in, band->width, band->height, y, y+1, band->ksize, col);
+		if(band->hists)
+			histogram_row(&band->hists[(unsigned long)index * HIST_SIZE], &band->img_out[(unsigned long)y*band->width], band->width);
+	}
+}
+
+void CPU_sobel_separable(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height, int ksize, short *row_bufs, unsigned int *hists)
+{
+	struct sobel_separable_args band = { img_out, img_in, width, height, ksize, row_bufs, hists };
+	workers_run(CPU_sobel_separable_band, &band);
+}
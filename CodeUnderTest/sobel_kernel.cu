@@ -21,6 +21,8 @@
 #include <stdio.h>
 #include <assert.h>
 
+#include "stencil.h"
+
 #define MAXRGB	 	255
 #define THRESHOLD	128
 
@@ -30,7 +32,6 @@
 __global__ void sobel_transform(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height)
 {
 	int x,y;
-	unsigned char LUp,LCnt,LDw,RUp,RCnt,RDw;
 	int pixel;
 	
 	x=blockDim.x*blockIdx.x+threadIdx.x;
@@ -38,15 +39,7 @@ __global__ void sobel_transform(unsigned char *img_out, unsigned char *img_in, u
 	
 	if( x<width && y<height )
 	{
-		LUp = (x-1>=0 && y-1>=0) ? img_in[(x-1)+(y-1)*width] : 0;
-		LCnt= (x-1>=0)           ? img_in[(x-1)+y*width]:0;
-		LDw = (x-1>=0 && y+1<height) ? img_in[(x-1)+(y+1)*width] : 0;
-		RUp = (x+1<width && y-1>=0)  ? img_in[(x+1)+(y-1)*width] : 0;
-		RCnt= (x+1<width)            ? img_in[(x+1)+y*width] : 0;
-		RDw = (x+1<width && y+1<height) ? img_in[(x+1)+(y+1)*width] : 0;
-		pixel = -1*LUp  + 1*RUp +
-		-2*LCnt + 2*RCnt +
-		-1*LDw  + 1*RDw;
+		pixel = stencil_at<sobel_x_op>(img_in, x, y, width, height);
 		pixel = (pixel<THRESHOLD) ? 0 : pixel;
 		pixel = (pixel>MAXRGB) ? MAXRGB : pixel;
 		if(pixel < THRESHOLD)
@@ -64,38 +57,3 @@ void sobel_transform_wrapper(unsigned char *img_out, unsigned char *img_in, unsi
 {
 	sobel_transform<<<grid, threads, 0>>>(img_out, img_in, width, height);
 }
-
-//***************************************************************//
-// Sobel transform using the CPU
-//***************************************************************//
-void CPU_transform(unsigned char *img_out, unsigned char *img_in, unsigned int width, unsigned int height) 
-{
-	unsigned char LUp,LCnt,LDw,RUp,RCnt,RDw;
-	int pixel;
-	for(int y=0; y<height; y++)
-	{
-		for(int x=0; x<width; x++)
-		{
-			#ifdef DEBUG
-				printf("Pixel X:%d Y:%d\n",x,y);
-			#endif
-			assert(x+(y*width)<width*height);
-			LUp = (x-1>=0 && y-1>=0)? img_in[(x-1)+(y-1)*width]:0;
-			LCnt= (x-1>=0)? img_in[(x-1)+y*width]:0;
-			LDw = (x-1>=0 && y+1<height)? img_in[(x-1)+(y+1)*width]:0;
-			RUp = (x+1<width && y-1>=0)? img_in[(x+1)+(y-1)*width]:0;
-			RCnt= (x+1<width)? img_in[(x+1)+y*width]:0;
-			RDw = (x+1<width && y+1<height)? img_in[(x+1)+(y+1)*width]:0;
-			pixel = -1*LUp  + 1*RUp + -2*LCnt + 2*RCnt + -1*LDw  + 1*RDw;
-			pixel=(pixel<0)?0:pixel;
-			pixel=(pixel>MAXRGB)?MAXRGB:pixel;
-			img_out[x+y*width]=pixel;
-			#ifdef DEBUG
-				printf("\r%5.2f",100*(float)(y*width+x)/(float)(width*height-1));            
-			#endif
-		}
-	}
-#ifdef DEBUG
-	printf("\n");
-#endif
-}
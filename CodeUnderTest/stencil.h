@@ -0,0 +1,111 @@
+//*****************************************************************************************//
+//  stencil.h - Compile time 3x3 stencil operators (Sobel, Scharr, Prewitt, Laplacian)
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	The coefficients of an operator are template arguments, so every tap is a
+//	compile time constant: zero taps are never read and the multiplies fold into
+//	adds, subtracts and shifts. This header has no SIMD code in it and can be used
+//	from the CUDA kernels as well as the CPU ones; the SIMD taps built on the same
+//	tables are in stencil_simd.h.
+//
+//*****************************************************************************************//
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <string.h>
+
+#ifdef __CUDACC__
+#define STENCIL_FN	__host__ __device__ inline
+#else
+#define STENCIL_FN	inline
+#endif
+
+// Coefficients in row major order: K<row><column>, row 0 is the row above
+template<int K00, int K01, int K02,
+         int K10, int K11, int K12,
+         int K20, int K21, int K22>
+struct stencil3x3
+{
+	enum { k00 = K00, k01 = K01, k02 = K02,
+	       k10 = K10, k11 = K11, k12 = K12,
+	       k20 = K20, k21 = K21, k22 = K22 };
+};
+
+typedef stencil3x3< -1,  0,  1,
+                    -2,  0,  2,
+                    -1,  0,  1 > sobel_x_op;
+typedef stencil3x3< -1, -2, -1,
+                     0,  0,  0,
+                     1,  2,  1 > sobel_y_op;
+typedef stencil3x3< -3,  0,  3,
+                   -10,  0, 10,
+                    -3,  0,  3 > scharr_x_op;
+typedef stencil3x3< -1,  0,  1,
+                    -1,  0,  1,
+                    -1,  0,  1 > prewitt_x_op;
+typedef stencil3x3<  0,  1,  0,
+                     1, -4,  1,
+                     0,  1,  0 > laplace_op;
+
+// Operators selectable at run time (-op=)
+typedef enum
+{
+	STENCIL_SOBEL,
+	STENCIL_SCHARR,
+	STENCIL_PREWITT,
+	STENCIL_LAPLACE
+} stencil_op_t;
+
+static inline bool stencil_parse_op(const char *name, stencil_op_t *op)
+{
+	if(strcmp(name, "sobel") == 0)
+		*op = STENCIL_SOBEL;
+	else if(strcmp(name, "scharr") == 0)
+		*op = STENCIL_SCHARR;
+	else if(strcmp(name, "prewitt") == 0)
+		*op = STENCIL_PREWITT;
+	else if(strcmp(name, "laplace") == 0)
+		*op = STENCIL_LAPLACE;
+	else
+		return false;
+	return true;
+}
+
+//***************************************************************//
+// Response of Op over the 3x3 neighbourhood p<row><column>
+//***************************************************************//
+template<class Op>
+STENCIL_FN int stencil_apply(int p00, int p01, int p02,
+                             int p10, int p11, int p12,
+                             int p20, int p21, int p22)
+{
+	return Op::k00*p00 + Op::k01*p01 + Op::k02*p02 +
+	       Op::k10*p10 + Op::k11*p11 + Op::k12*p12 +
+	       Op::k20*p20 + Op::k21*p21 + Op::k22*p22;
+}
+
+//***************************************************************//
+// Response of Op at (x, y) of a zero padded image. The branches on
+// the coefficients are resolved at compile time.
+//***************************************************************//
+#define STENCIL_TAP(K, dx, dy) \
+	if((K) != 0) { \
+		int xx = x + (dx), yy = y + (dy); \
+		if(xx >= 0 && xx < width && yy >= 0 && yy < height) \
+			sum += (K) * img[xx + yy*width]; \
+	}
+
+template<class Op>
+STENCIL_FN int stencil_at(const unsigned char *img, int x, int y, int width, int height)
+{
+	int sum = 0;
+	STENCIL_TAP(Op::k00, -1, -1) STENCIL_TAP(Op::k01, 0, -1) STENCIL_TAP(Op::k02, 1, -1)
+	STENCIL_TAP(Op::k10, -1,  0) STENCIL_TAP(Op::k11, 0,  0) STENCIL_TAP(Op::k12, 1,  0)
+	STENCIL_TAP(Op::k20, -1,  1) STENCIL_TAP(Op::k21, 0,  1) STENCIL_TAP(Op::k22, 1,  1)
+	return sum;
+}
+
+#undef STENCIL_TAP
+
+#endif
@@ -0,0 +1,106 @@
+//*****************************************************************************************//
+//  stencil_simd.h - SSE2/AVX2 taps for the compile time 3x3 stencils of stencil.h
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	Host compiler only: the intrinsics headers must never go through nvcc. The sums
+//	are the signed 16 bit responses of an operator, 16 (SSE2) or 32 (AVX2) pixels
+//	at a time; sobel_cpu.cpp packs them to 8 bits, gradient.cpp keeps the sign.
+//
+//*****************************************************************************************//
+#ifndef STENCIL_SIMD_H
+#define STENCIL_SIMD_H
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "stencil.h"
+
+#if defined(__AVX2__)
+//***************************************************************//
+// One AVX2 tap: acc += K * p[0..31] on 16 bit lanes. Zero taps are
+// never loaded and +/-1, +/-2 avoid the multiply.
+//***************************************************************//
+template<int K> struct stencil_avx2
+{
+	static inline __m256i madd(__m256i acc, __m256i v) { return _mm256_add_epi16(acc, _mm256_mullo_epi16(v, _mm256_set1_epi16(K))); }
+	static inline void tap(__m256i &lo, __m256i &hi, const unsigned char *p)
+	{
+		__m256i zero = _mm256_setzero_si256();
+		__m256i v = _mm256_loadu_si256((const __m256i *)p);
+		lo = madd(lo, _mm256_unpacklo_epi8(v, zero));
+		hi = madd(hi, _mm256_unpackhi_epi8(v, zero));
+	}
+};
+template<> inline void stencil_avx2<0>::tap(__m256i &, __m256i &, const unsigned char *) {}
+template<> inline __m256i stencil_avx2<1>::madd(__m256i acc, __m256i v) { return _mm256_add_epi16(acc, v); }
+template<> inline __m256i stencil_avx2<-1>::madd(__m256i acc, __m256i v) { return _mm256_sub_epi16(acc, v); }
+template<> inline __m256i stencil_avx2<2>::madd(__m256i acc, __m256i v) { return _mm256_add_epi16(acc, _mm256_add_epi16(v, v)); }
+template<> inline __m256i stencil_avx2<-2>::madd(__m256i acc, __m256i v) { return _mm256_sub_epi16(acc, _mm256_add_epi16(v, v)); }
+
+//***************************************************************//
+// Op summed over pixels x..x+31, needs 1 <= x and x+32 < width. The
+// unpacks work per 128 bit lane: lo holds pixels 0-7 and 16-23, hi
+// 8-15 and 24-31. The response of every operator fits in 16 bits.
+//***************************************************************//
+template<class Op>
+static inline void stencil_sums_32(__m256i &lo, __m256i &hi, const unsigned char *above, const unsigned char *mid, const unsigned char *below, int x)
+{
+	lo = _mm256_setzero_si256();
+	hi = _mm256_setzero_si256();
+	stencil_avx2<Op::k00>::tap(lo, hi, above+x-1);
+	stencil_avx2<Op::k01>::tap(lo, hi, above+x);
+	stencil_avx2<Op::k02>::tap(lo, hi, above+x+1);
+	stencil_avx2<Op::k10>::tap(lo, hi, mid+x-1);
+	stencil_avx2<Op::k11>::tap(lo, hi, mid+x);
+	stencil_avx2<Op::k12>::tap(lo, hi, mid+x+1);
+	stencil_avx2<Op::k20>::tap(lo, hi, below+x-1);
+	stencil_avx2<Op::k21>::tap(lo, hi, below+x);
+	stencil_avx2<Op::k22>::tap(lo, hi, below+x+1);
+}
+#endif
+
+#if defined(__SSE2__)
+//***************************************************************//
+// One SSE2 tap: acc += K * p[0..15] on 16 bit lanes
+//***************************************************************//
+template<int K> struct stencil_sse
+{
+	static inline __m128i madd(__m128i acc, __m128i v) { return _mm_add_epi16(acc, _mm_mullo_epi16(v, _mm_set1_epi16(K))); }
+	static inline void tap(__m128i &lo, __m128i &hi, const unsigned char *p)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		lo = madd(lo, _mm_unpacklo_epi8(v, zero));
+		hi = madd(hi, _mm_unpackhi_epi8(v, zero));
+	}
+};
+template<> inline void stencil_sse<0>::tap(__m128i &, __m128i &, const unsigned char *) {}
+template<> inline __m128i stencil_sse<1>::madd(__m128i acc, __m128i v) { return _mm_add_epi16(acc, v); }
+template<> inline __m128i stencil_sse<-1>::madd(__m128i acc, __m128i v) { return _mm_sub_epi16(acc, v); }
+template<> inline __m128i stencil_sse<2>::madd(__m128i acc, __m128i v) { return _mm_add_epi16(acc, _mm_add_epi16(v, v)); }
+template<> inline __m128i stencil_sse<-2>::madd(__m128i acc, __m128i v) { return _mm_sub_epi16(acc, _mm_add_epi16(v, v)); }
+
+//***************************************************************//
+// Op summed over pixels x..x+15 (lo 0-7, hi 8-15), needs 1 <= x
+// and x+16 < width
+//***************************************************************//
+template<class Op>
+static inline void stencil_sums_16(__m128i &lo, __m128i &hi, const unsigned char *above, const unsigned char *mid, const unsigned char *below, int x)
+{
+	lo = _mm_setzero_si128();
+	hi = _mm_setzero_si128();
+	stencil_sse<Op::k00>::tap(lo, hi, above+x-1);
+	stencil_sse<Op::k01>::tap(lo, hi, above+x);
+	stencil_sse<Op::k02>::tap(lo, hi, above+x+1);
+	stencil_sse<Op::k10>::tap(lo, hi, mid+x-1);
+	stencil_sse<Op::k11>::tap(lo, hi, mid+x);
+	stencil_sse<Op::k12>::tap(lo, hi, mid+x+1);
+	stencil_sse<Op::k20>::tap(lo, hi, below+x-1);
+	stencil_sse<Op::k21>::tap(lo, hi, below+x);
+	stencil_sse<Op::k22>::tap(lo, hi, below+x+1);
+}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+//*****************************************************************************************//
+//  workers.cpp - Persistent worker threads shared by the CPU transforms
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//*****************************************************************************************//
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "workers.h"
+
+#define MAX_WORKERS		64
+
+static pthread_t worker_threads[MAX_WORKERS];
+static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_go = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t worker_done = PTHREAD_COND_INITIALIZER;
+static int worker_total = 1;		// including the calling thread
+static int worker_pending = 0;		// workers still running the current job
+static unsigned int worker_generation = 0;
+static bool worker_exit = false;
+static worker_job_t worker_job = NULL;
+static void *worker_arg = NULL;
+
+//***************************************************************//
+// Worker thread body, waits for a new generation and runs its slice
+//***************************************************************//
+static void *worker_main(void *threadp)
+{
+	int index = (int)(long)threadp;
+	unsigned int seen = 0;
+	
+	pthread_mutex_lock(&worker_lock);
+	for(;;)
+	{
+		while(worker_generation == seen && !worker_exit)
+			pthread_cond_wait(&worker_go, &worker_lock);
+		if(worker_exit)
+			break;
+		seen = worker_generation;
+		worker_job_t job = worker_job;
+		void *arg = worker_arg;
+		int count = worker_total;
+		pthread_mutex_unlock(&worker_lock);
+		
+		job(arg, index, count);
+		
+		pthread_mutex_lock(&worker_lock);
+		if(--worker_pending == 0)
+			pthread_cond_signal(&worker_done);
+	}
+	pthread_mutex_unlock(&worker_lock);
+	return NULL;
+}
+
+bool workers_start(int count)
+{
+	if(count < 1) count = 1;
+	if(count > MAX_WORKERS) count = MAX_WORKERS;
+	
+	workers_stop();
+	worker_exit = false;
+	worker_generation = 0;	// no threads alive, new ones start from zero
+	worker_total = 1;
+	
+	for(int i = 1; i < count; i++)
+	{
+		if(pthread_create(&worker_threads[i], NULL, worker_main, (void *)(long)i) != 0)
+		{
+			perror("workers_start");
+			workers_stop();
+			return false;
+		}
+		worker_total = i + 1;
+	}
+	return true;
+}
+
+void workers_run(worker_job_t job, void *arg)
+{
+	if(worker_total == 1)
+	{
+		job(arg, 0, 1);
+		return;
+	}
+	
+	pthread_mutex_lock(&worker_lock);
+	worker_job = job;
+	worker_arg = arg;
+	worker_pending = worker_total - 1;
+	worker_generation++;
+	pthread_cond_broadcast(&worker_go);
+	pthread_mutex_unlock(&worker_lock);
+	
+	// The caller takes the first slice itself
+	job(arg, 0, worker_total);
+	
+	pthread_mutex_lock(&worker_lock);
+	while(worker_pending > 0)
+		pthread_cond_wait(&worker_done, &worker_lock);
+	pthread_mutex_unlock(&worker_lock);
+}
+
+void workers_stop(void)
+{
+	if(worker_total == 1)
+		return;
+	
+	pthread_mutex_lock(&worker_lock);
+	worker_exit = true;
+	pthread_cond_broadcast(&worker_go);
+	pthread_mutex_unlock(&worker_lock);
+	
+	for(int i = 1; i < worker_total; i++)
+		pthread_join(worker_threads[i], NULL);
+	worker_total = 1;
+}
+
+int workers_count(void)
+{
+	return worker_total;
+}
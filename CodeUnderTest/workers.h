@@ -0,0 +1,30 @@
+//*****************************************************************************************//
+//  workers.h - Persistent worker threads shared by the CPU transforms
+//
+//  Authors: Matthew Demi Vis, Embry-Riddle Aeronautical University (MatthewVis@gmail.com)
+//
+//	The benchmarks run continuously, so the CPU transforms must not pay for a
+//	pthread_create() every frame. workers_start() creates the threads once and
+//	workers_run() hands each of them a slice of the current frame.
+//
+//*****************************************************************************************//
+#ifndef WORKERS_H
+#define WORKERS_H
+
+// A job is called once per worker with its index in [0, count)
+typedef void (*worker_job_t)(void *arg, int index, int count);
+
+// Start count-1 worker threads; the calling thread acts as worker 0.
+// Returns false if the threads could not be created.
+bool workers_start(int count);
+
+// Run job on every worker and wait for all of them to finish
+void workers_run(worker_job_t job, void *arg);
+
+// Stop and join the worker threads
+void workers_stop(void);
+
+// Number of workers taking part in workers_run() (1 if never started)
+int workers_count(void);
+
+#endif